@@ -0,0 +1,370 @@
+#pragma once
+
+#include "workload.h"
+
+#include <map>
+#include <set>
+#include <utility>
+
+
+// Reference engines built on the ordered containers of the standard library, to compare range_allocator
+// with: a std::map of the free spans by address, and a pair of std::set indices, by address and by length.
+// They have the interface of range_allocator used by the harness, and place the ranges like it with the
+// default placement policy, except for ALLOCATE_ANY in baseline_set_allocator, which takes the smallest span
+// that fits from the index by length (best fit) instead of the first one by address.
+
+
+// Placement of an allocation in an index of the free spans ordered by address, whose elements are pairs
+// (base, length): std::map<vaddr_t, size_t> or std::set<std::pair<vaddr_t, size_t> >.
+// find() returns the base of the allocated range and the span that contains it in <it>, or (vaddr_t)-1.
+template <class Index>
+class address_placement
+{
+public:
+    typedef typename Index::iterator iterator;
+
+    address_placement(vaddr_t origin, size_t granularity)
+        : _origin(origin), _granularity(granularity)
+    {}
+
+    vaddr_t find(Index& index, size_t length, allocation_flags flags, vaddr_t hint, iterator& it) const
+    {
+        switch (flags)
+        {
+        case ALLOCATE_ANY:
+            return first_fit(index, index.begin(), length, it);
+        case ALLOCATE_EXACT:
+            return exact(index, length, hint, it);
+        case ALLOCATE_ABOVE:
+            return above(index, length, hint, it);
+        case ALLOCATE_BELOW:
+            return below(index, length, hint, it);
+        case ALLOCATE_NEAR:
+            return near(index, length, hint, it);
+        }
+        return (vaddr_t)-1;
+    }
+
+private:
+    // lowest span from <from> that has at least <length> bytes
+    static vaddr_t first_fit(Index& index, iterator from, size_t length, iterator& it)
+    {
+        for (it = from; it != index.end(); ++it)
+        {
+            if (it->second >= length) return it->first;
+        }
+        return (vaddr_t)-1;
+    }
+
+    // span that contains [hint, hint+length[, the last one starting at or below the hint
+    static iterator containing(Index& index, vaddr_t hint)
+    {
+        iterator it = index.upper_bound(key(hint));
+        if (it == index.begin()) return index.end();
+        return --it;
+    }
+
+    static vaddr_t exact(Index& index, size_t length, vaddr_t hint, iterator& it)
+    {
+        it = containing(index, hint);
+        if (it == index.end() || hint + length > it->first + it->second) return (vaddr_t)-1;
+        return hint;
+    }
+
+    // upper end of the first span that has enough bytes above the hint
+    static vaddr_t above(Index& index, size_t length, vaddr_t hint, iterator& it)
+    {
+        it = containing(index, hint);
+        if (it != index.end() && it->first + it->second >= hint + length)
+            return it->first + it->second - length;
+
+        if (first_fit(index, index.upper_bound(key(hint)), length, it) == (vaddr_t)-1) return (vaddr_t)-1;
+        return it->first + it->second - length;
+    }
+
+    // lower end of the first span that has enough bytes below the hint
+    static vaddr_t below(Index& index, size_t length, vaddr_t hint, iterator& it)
+    {
+        for (it = index.begin(); it != index.end() && it->first + length <= hint; ++it)
+        {
+            if (it->second >= length) return it->first;
+        }
+        return (vaddr_t)-1;
+    }
+
+    // closest base to the hint, walking the spans away from it on both sides
+    vaddr_t near(Index& index, size_t length, vaddr_t hint, iterator& it) const
+    {
+        vaddr_t best_base = (vaddr_t)-1;
+        size_t  best_distance = (size_t)-1;
+
+        iterator up = index.upper_bound(key(hint));
+        for (iterator current = up; current != index.end() && current->first - hint < best_distance; ++current)
+        {
+            consider(current, length, hint, it, best_base, best_distance);
+        }
+        for (iterator current = up; current != index.begin(); )
+        {
+            --current;
+            if (current->first + current->second <= hint && hint - (current->first + current->second) > best_distance)
+                break;
+            consider(current, length, hint, it, best_base, best_distance);
+        }
+        return best_base;
+    }
+
+    void consider(iterator current, size_t length, vaddr_t hint, iterator& it, vaddr_t& best_base, size_t& best_distance) const
+    {
+        if (current->second < length) return;
+
+        // lowest and highest possible base addresses in the span, on the granularity
+        vaddr_t lowest = current->first;
+        vaddr_t highest = current->first + current->second - length;
+
+        vaddr_t base = lowest;
+        if (hint >= highest)
+            base = highest;
+        else if (hint > lowest)
+        {
+            vaddr_t below = _origin + ((hint - _origin) / _granularity) * _granularity;
+            vaddr_t above = (below == hint) ? hint : below + _granularity;
+            base = (hint - below <= above - hint) ? below : above;
+        }
+
+        // the lowest base wins between two at the same distance
+        size_t distance = (base > hint) ? base - hint : hint - base;
+        if (distance < best_distance || (distance == best_distance && base < best_base))
+        {
+            it = current;
+            best_base = base;
+            best_distance = distance;
+        }
+    }
+
+    // key of the index whose elements start at <base>: the greatest one, so that upper_bound() skips them
+    static typename Index::key_type key(vaddr_t base)
+    {
+        return key_of(base, (typename Index::key_type*)0);
+    }
+    static vaddr_t key_of(vaddr_t base, vaddr_t*)
+    {
+        return base;
+    }
+    static std::pair<vaddr_t, size_t> key_of(vaddr_t base, std::pair<vaddr_t, size_t>*)
+    {
+        return std::make_pair(base, (size_t)-1);
+    }
+
+    vaddr_t _origin;
+    size_t  _granularity;
+};
+
+
+// Common part of the baseline engines: the range, the granularity and the rounding of the requests.
+class baseline_range
+{
+public:
+    baseline_range(vaddr_t base, size_t length, size_t granularity)
+        : _base(base), _granularity(granularity)
+        , _length((length / granularity) * granularity)
+    {}
+
+protected:
+    // Aligns the length to the upper granularity boundary. Returns 0 if the request cannot be satisfied.
+    size_t round_length(size_t length) const
+    {
+        length = ((length + _granularity - 1) / _granularity) * _granularity;
+        return (length > _length) ? 0 : length;
+    }
+
+    vaddr_t _base;
+    size_t  _granularity;
+    size_t  _length;
+};
+
+
+// Free spans in a std::map from their base to their length.
+class baseline_map_allocator : public baseline_range
+{
+public:
+    typedef std::map<vaddr_t, size_t> index;
+
+    baseline_map_allocator(vaddr_t base, size_t length, size_t granularity)
+        : baseline_range(base, length, granularity), _placement(base % granularity, granularity)
+    {
+        if (_length) _spans[_base] = _length;
+    }
+
+    vaddr_t allocate(size_t length, allocation_flags flags, vaddr_t hint)
+    {
+        length = round_length(length);
+        if (length == 0) return (vaddr_t)-1;
+
+        index::iterator it;
+        vaddr_t base = _placement.find(_spans, length, flags, hint, it);
+        if (base == (vaddr_t)-1) return base;
+
+        // the low part keeps its entry, the high part is a new one
+        vaddr_t end = it->first + it->second;
+        if (base == it->first)
+            _spans.erase(it);
+        else
+            it->second = base - it->first;
+        if (base + length < end)
+            _spans.insert(std::make_pair(base + length, end - base - length));
+        return base;
+    }
+
+    void free(vaddr_t base, size_t length)
+    {
+        base = (base / _granularity) * _granularity;
+        length = ((length + _granularity - 1) / _granularity) * _granularity;
+        if (length == 0) return;
+
+        // merge with the previous and the next spans when they are contiguous
+        index::iterator next = _spans.upper_bound(base);
+        index::iterator it = next;
+        if (it != _spans.begin() && (--it)->first + it->second == base)
+            it->second += length;
+        else
+            it = _spans.insert(next, std::make_pair(base, length));
+
+        if (next != _spans.end() && base + length == next->first)
+        {
+            it->second += next->second;
+            _spans.erase(next);
+        }
+    }
+
+    const index& spans() const
+    {
+        return _spans;
+    }
+
+private:
+    index                    _spans;
+    address_placement<index> _placement;
+};
+
+
+// Free spans in two std::set: by address for the placement, and by length then address for the best fit.
+class baseline_set_allocator : public baseline_range
+{
+public:
+    typedef std::set<std::pair<vaddr_t, size_t> > address_index;
+    typedef std::set<std::pair<size_t, vaddr_t> > length_index;
+
+    baseline_set_allocator(vaddr_t base, size_t length, size_t granularity)
+        : baseline_range(base, length, granularity), _placement(base % granularity, granularity)
+    {
+        if (_length) insert(_base, _length);
+    }
+
+    vaddr_t allocate(size_t length, allocation_flags flags, vaddr_t hint)
+    {
+        length = round_length(length);
+        if (length == 0) return (vaddr_t)-1;
+
+        address_index::iterator it;
+        vaddr_t base;
+        if (flags == ALLOCATE_ANY)
+        {
+            // smallest span that fits, the lowest one among those of the same length
+            length_index::iterator fit = _by_length.lower_bound(std::make_pair(length, (vaddr_t)0));
+            if (fit == _by_length.end()) return (vaddr_t)-1;
+            base = fit->second;
+            it = _by_address.find(std::make_pair(fit->second, fit->first));
+        }
+        else
+        {
+            base = _placement.find(_by_address, length, flags, hint, it);
+            if (base == (vaddr_t)-1) return base;
+        }
+
+        vaddr_t span_base = it->first;
+        vaddr_t end = it->first + it->second;
+        erase(span_base, it->second);
+        if (span_base < base) insert(span_base, base - span_base);
+        if (base + length < end) insert(base + length, end - base - length);
+        return base;
+    }
+
+    void free(vaddr_t base, size_t length)
+    {
+        base = (base / _granularity) * _granularity;
+        length = ((length + _granularity - 1) / _granularity) * _granularity;
+        if (length == 0) return;
+
+        // merge with the previous and the next spans when they are contiguous
+        address_index::iterator next = _by_address.upper_bound(std::make_pair(base, (size_t)-1));
+        if (next != _by_address.end() && base + length == next->first)
+        {
+            length += next->second;
+            erase(next->first, next->second);
+            next = _by_address.upper_bound(std::make_pair(base, (size_t)-1));
+        }
+        if (next != _by_address.begin())
+        {
+            address_index::iterator previous = next;
+            --previous;
+            if (previous->first + previous->second == base)
+            {
+                base = previous->first;
+                length += previous->second;
+                erase(previous->first, previous->second);
+            }
+        }
+        insert(base, length);
+    }
+
+    const address_index& spans() const
+    {
+        return _by_address;
+    }
+
+    const length_index& lengths() const
+    {
+        return _by_length;
+    }
+
+private:
+    void insert(vaddr_t base, size_t length)
+    {
+        _by_address.insert(std::make_pair(base, length));
+        _by_length.insert(std::make_pair(length, base));
+    }
+
+    void erase(vaddr_t base, size_t length)
+    {
+        _by_address.erase(std::make_pair(base, length));
+        _by_length.erase(std::make_pair(length, base));
+    }
+
+    address_index                    _by_address;
+    length_index                     _by_length;
+    address_placement<address_index> _placement;
+};
+
+
+inline void measure_free_space(const baseline_map_allocator& engine, free_space& space)
+{
+    space.span_count = engine.spans().size();
+    space.free_bytes = 0;
+    space.largest_span = 0;
+    for (baseline_map_allocator::index::const_iterator it = engine.spans().begin(); it != engine.spans().end(); ++it)
+    {
+        space.free_bytes += it->second;
+        if (it->second > space.largest_span) space.largest_span = it->second;
+    }
+}
+
+inline void measure_free_space(const baseline_set_allocator& engine, free_space& space)
+{
+    space.span_count = engine.spans().size();
+    space.free_bytes = 0;
+    for (baseline_set_allocator::address_index::const_iterator it = engine.spans().begin(); it != engine.spans().end(); ++it)
+    {
+        space.free_bytes += it->second;
+    }
+    space.largest_span = engine.lengths().empty() ? 0 : engine.lengths().rbegin()->first;
+}
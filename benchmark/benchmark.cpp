@@ -0,0 +1,97 @@
+#include "baselines.h"
+#include "harness.h"
+#include "workload.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+// Number of span visits per measured batch: the iterations are reduced for the long lists, so that each
+// case runs in a bounded time.
+const size_t visit_budget = 20000000;
+
+// Runs the cost of each operation across fragmentation levels.
+static void run_microbenchmarks(size_t max_spans)
+{
+    const size_t granularities[] = { 64, 4096 };
+    const size_t range_blocks[] = { 2, 16 };
+
+    print_header();
+    for (size_t g = 0; g < sizeof(granularities) / sizeof(granularities[0]); g++)
+    {
+        for (size_t spans = 1; spans <= max_spans; spans *= 10)
+        {
+            for (size_t r = 0; r < sizeof(range_blocks) / sizeof(range_blocks[0]); r++)
+            {
+                bench_config config;
+                config.granularity = granularities[g];
+                config.span_count = spans;
+                config.range_blocks = range_blocks[r];
+                config.iterations = visit_budget / spans;
+                if (config.iterations > 10000) config.iterations = 10000;
+                if (config.iterations < 10) config.iterations = 10;
+
+                run_case<range_allocator<span_manager_pool> >("span_manager_pool", config);
+                run_case<range_allocator<span_manager_allocate> >("span_manager_allocate", config);
+                run_case<baseline_map_allocator>("baseline_map", config);
+                run_case<baseline_set_allocator>("baseline_set", config);
+            }
+        }
+    }
+}
+
+// Runs the synthetic workloads: each size distribution with each lifetime distribution.
+static void run_workloads(size_t operations)
+{
+    static const char* names[3][3] = {
+        { "uniform/lifo", "uniform/fifo", "uniform/random" },
+        { "power-law/lifo", "power-law/fifo", "power-law/random" },
+        { "bimodal/lifo", "bimodal/fifo", "bimodal/random" },
+    };
+
+    print_workload_header();
+    for (int sizes = SIZE_UNIFORM; sizes <= SIZE_BIMODAL; sizes++)
+    {
+        for (int lifetimes = LIFETIME_LIFO; lifetimes <= LIFETIME_RANDOM; lifetimes++)
+        {
+            workload_config config;
+            config.name = names[sizes][lifetimes];
+            config.granularity = 4096;
+            config.length = (size_t)1 << 32;
+            config.occupancy = 0.8;
+            config.sizes = (size_distribution)sizes;
+            config.min_blocks = 1;
+            config.max_blocks = 256;
+            config.size_alpha = 1.2;
+            config.small_ratio = 0.9;
+            config.lifetimes = (lifetime_distribution)lifetimes;
+            config.flag_weights[0] = 70;
+            config.flag_weights[1] = 10;
+            config.flag_weights[2] = 10;
+            config.flag_weights[3] = 10;
+            config.hints = HINT_UNIFORM;
+            config.operations = operations;
+            config.report_interval = operations / 10;
+            config.seed = 42;
+
+            run_workload<range_allocator<span_manager_pool> >("span_manager_pool", config);
+            run_workload<range_allocator<span_manager_allocate> >("span_manager_allocate", config);
+            run_workload<baseline_map_allocator>("baseline_map", config);
+            run_workload<baseline_set_allocator>("baseline_set", config);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // usage: benchmark [max_spans]
+    //        benchmark workload [operations]
+    if (argc > 1 && strcmp(argv[1], "workload") == 0)
+    {
+        run_workloads((argc > 2) ? strtoul(argv[2], 0, 10) : 1000000);
+        return 0;
+    }
+
+    run_microbenchmarks((argc > 1) ? strtoul(argv[1], 0, 10) : 1000000);
+    return 0;
+}
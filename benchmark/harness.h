@@ -0,0 +1,182 @@
+#pragma once
+
+#include "../rangeallocatorimpl.h"
+#include "perfcounters.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+
+// Parameters of a benchmark case.
+struct bench_config
+{
+    size_t granularity;     // granularity of the allocator
+    size_t span_count;      // number of free spans in the list before the measured operations
+    size_t range_blocks;    // length of the measured ranges, in blocks of <granularity> bytes
+    size_t iterations;      // number of measured operations of each kind
+};
+
+// Result of a measured operation.
+struct bench_result
+{
+    const char* operation;
+    double      ns_per_op;
+    size_t      failures;
+    int64_t     events[PERF_COUNTER_COUNT];     // hardware events of the batch, or perf_counters::unavailable
+};
+
+
+// Measures the elapsed time of a batch of operations.
+class bench_timer
+{
+public:
+    bench_timer()
+        : _start(std::chrono::steady_clock::now())
+    {}
+
+    double elapsed_ns() const
+    {
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point _start;
+};
+
+
+// Runs the benchmark cases against an engine. The engine is any class with the interface of range_allocator:
+//   Engine(vaddr_t base, size_t length, size_t granularity);
+//   vaddr_t allocate(size_t length, allocation_flags flags, vaddr_t hint);
+//   void free(vaddr_t base, size_t length);
+template <class Engine>
+class bench_harness
+{
+public:
+    static const vaddr_t base = 0x10000000;
+
+    // Layout of the range before each measured batch: <span_count> - 1 holes of one block, each followed by
+    // an allocated block, then a free tail large enough for all the measured ranges.
+    //
+    // |_-_-_-_-_-_-_-_-_-_-_-_-_-_-_-______________________|
+    //                               ^ tail
+    // The measured ranges are larger than the holes, so that each operation walks the whole list of spans.
+    explicit bench_harness(const bench_config& config)
+        : _config(config)
+        , _length(config.granularity * (2 * (config.span_count - 1) + config.range_blocks * config.iterations))
+        , _tail(base + config.granularity * 2 * (config.span_count - 1))
+        , _bases(config.iterations)
+    {}
+
+    // Measures each allocation flag and the release of the allocated ranges.
+    void run(std::vector<bench_result>& results)
+    {
+        const size_t length = _config.range_blocks * _config.granularity;
+        const vaddr_t end = base + _length;
+
+        measure(results, "allocate ANY", "free", ALLOCATE_ANY, 0, 0);
+        measure(results, "allocate EXACT", "free", ALLOCATE_EXACT, _tail, length);
+        measure(results, "allocate ABOVE", "free", ALLOCATE_ABOVE, _tail, 0);
+        measure(results, "allocate BELOW", "free", ALLOCATE_BELOW, end, 0);
+        measure(results, "allocate NEAR", "free", ALLOCATE_NEAR, end, 0);
+    }
+
+private:
+    // Measures a batch of allocations with the flag, then the release of the allocated ranges.
+    // The hint of the i-th allocation is <hint> + i * <hint_step>.
+    void measure(std::vector<bench_result>& results, const char* allocate_name, const char* free_name,
+                 allocation_flags flags, vaddr_t hint, size_t hint_step)
+    {
+        const size_t length = _config.range_blocks * _config.granularity;
+
+        Engine engine(base, _length, _config.granularity);
+        fragment(engine);
+
+        bench_result allocate_result = { allocate_name, 0, 0, {} };
+        _counters.start();
+        bench_timer allocate_timer;
+        for (size_t i = 0; i < _config.iterations; i++)
+        {
+            _bases[i] = engine.allocate(length, flags, hint + i * hint_step);
+        }
+        double allocate_ns = allocate_timer.elapsed_ns();
+        _counters.stop(allocate_result.events);
+
+        for (size_t i = 0; i < _config.iterations; i++)
+        {
+            if (_bases[i] == (vaddr_t)-1) allocate_result.failures++;
+        }
+        allocate_result.ns_per_op = allocate_ns / _config.iterations;
+        results.push_back(allocate_result);
+
+        bench_result free_result = { free_name, 0, 0, {} };
+        _counters.start();
+        bench_timer free_timer;
+        for (size_t i = 0; i < _config.iterations; i++)
+        {
+            if (_bases[i] != (vaddr_t)-1)
+                engine.free(_bases[i], length);
+        }
+        double free_ns = free_timer.elapsed_ns();
+        _counters.stop(free_result.events);
+
+        free_result.ns_per_op = free_ns / _config.iterations;
+        results.push_back(free_result);
+    }
+
+    // Builds the fragmented layout: the whole range is allocated, then the tail and the holes are released.
+    // They are released from the highest address, so that each one is inserted at the head of the list.
+    void fragment(Engine& engine)
+    {
+        const size_t g = _config.granularity;
+
+        engine.allocate(_length, ALLOCATE_EXACT, base);
+        engine.free(_tail, base + _length - _tail);
+        for (size_t i = _config.span_count - 1; i > 0; i--)
+        {
+            engine.free(base + 2 * (i - 1) * g, g);
+        }
+    }
+
+    bench_config         _config;
+    size_t               _length;
+    vaddr_t              _tail;
+    std::vector<vaddr_t> _bases;
+    perf_counters        _counters;
+};
+
+
+// Prints the header of the table of results. The hardware events are per operation.
+inline void print_header()
+{
+    printf("%-24s %12s %10s %8s  %-16s %12s %10s", "engine", "granularity", "spans", "blocks", "operation", "ns/op", "failures");
+    printf(" %10s %10s %10s %10s %10s %10s\n", "cycles", "instr", "L1D miss", "LLC miss", "br miss", "dTLB miss");
+}
+
+// Prints the results of a case, with a dash for the hardware events that could not be counted.
+inline void print_results(const char* engine_name, const bench_config& config, const std::vector<bench_result>& results)
+{
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        printf("%-24s %12zu %10zu %8zu  %-16s %12.1f %10zu", engine_name, config.granularity, config.span_count,
+               config.range_blocks, results[i].operation, results[i].ns_per_op, results[i].failures);
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+        {
+            if (results[i].events[c] == perf_counters::unavailable)
+                printf(" %10s", "-");
+            else
+                printf(" %10.1f", (double)results[i].events[c] / config.iterations);
+        }
+        printf("\n");
+    }
+}
+
+// Runs a case against an engine and prints its results.
+template <class Engine>
+void run_case(const char* engine_name, const bench_config& config)
+{
+    std::vector<bench_result> results;
+    bench_harness<Engine> harness(config);
+    harness.run(results);
+    print_results(engine_name, config, results);
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__linux__) && !defined(BENCHMARK_NO_PERF_COUNTERS) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BENCHMARK_PERF_COUNTERS
+#endif
+#endif
+
+
+// Hardware counters of the measured batches, read with perf_event_open() on Linux, for the calling thread
+// in user mode. A counter that cannot be opened (no PMU in a virtual machine, kernel.perf_event_paranoid,
+// other platforms, or BENCHMARK_NO_PERF_COUNTERS defined) is reported as unavailable, and the benchmark
+// falls back to the elapsed time. When there are more counters than hardware registers, the kernel
+// multiplexes them and the values are extrapolated from the time each one was running.
+
+enum perf_counter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,        // L1 data cache read misses
+    PERF_LLC_MISSES,        // last level cache misses
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,       // data TLB read misses
+
+    PERF_COUNTER_COUNT
+};
+
+class perf_counters
+{
+public:
+    // value of a counter that is not available
+    static const int64_t unavailable = -1;
+
+    perf_counters()
+    {
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            _fds[i] = open((perf_counter)i);
+        }
+    }
+
+    ~perf_counters()
+    {
+#if defined(BENCHMARK_PERF_COUNTERS)
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (_fds[i] != -1) close(_fds[i]);
+        }
+#endif
+    }
+
+    bool available() const
+    {
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (_fds[i] != -1) return true;
+        }
+        return false;
+    }
+
+    void start()
+    {
+#if defined(BENCHMARK_PERF_COUNTERS)
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (_fds[i] == -1) continue;
+            ioctl(_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Stops the counters and returns the number of events since start(), or <unavailable>.
+    void stop(int64_t values[PERF_COUNTER_COUNT])
+    {
+#if defined(BENCHMARK_PERF_COUNTERS)
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (_fds[i] != -1) ioctl(_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+#endif
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            values[i] = read(i);
+        }
+    }
+
+private:
+#if defined(BENCHMARK_PERF_COUNTERS)
+    static int open(perf_counter counter)
+    {
+        static const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+        perf_event_attr attr = perf_event_attr();
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        switch (counter)
+        {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+            break;
+        case PERF_LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PERF_BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PERF_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+            break;
+        default:
+            return -1;
+        }
+
+        // this thread, on any CPU, without group
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    int64_t read(int i) const
+    {
+        if (_fds[i] == -1) return unavailable;
+
+        // value, time enabled, time running
+        uint64_t data[3];
+        if (::read(_fds[i], data, sizeof(data)) != (ssize_t)sizeof(data)) return unavailable;
+        if (data[2] == 0) return 0;
+        if (data[2] < data[1]) return (int64_t)((double)data[0] * data[1] / data[2]);
+        return (int64_t)data[0];
+    }
+#else
+    static int open(perf_counter)
+    {
+        return -1;
+    }
+
+    int64_t read(int) const
+    {
+        return unavailable;
+    }
+#endif
+
+    int _fds[PERF_COUNTER_COUNT];
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "harness.h"
+
+#include <deque>
+#include <math.h>
+#include <random>
+
+
+// Synthetic workloads: the engine is driven to a steady state where the allocated bytes oscillate around a
+// target occupancy of the range, with sizes, lifetimes, flags and hints drawn from the configured distributions.
+
+enum size_distribution
+{
+    SIZE_UNIFORM,       // uniform between min_blocks and max_blocks
+    SIZE_POWER_LAW,     // Pareto with exponent size_alpha, from min_blocks, truncated at max_blocks
+    SIZE_BIMODAL        // min_blocks with probability small_ratio, max_blocks otherwise
+};
+
+enum lifetime_distribution
+{
+    LIFETIME_LIFO,      // the last allocated range is released first
+    LIFETIME_FIFO,      // the first allocated range is released first
+    LIFETIME_RANDOM     // any allocated range can be released
+};
+
+enum hint_distribution
+{
+    HINT_UNIFORM,       // uniform over the range
+    HINT_HOTSPOT        // normal around the middle of the range, with a standard deviation of 1/16 of its length
+};
+
+struct workload_config
+{
+    const char*           name;
+    size_t                granularity;
+    size_t                length;           // length of the range
+    double                occupancy;        // target ratio of allocated bytes
+    size_distribution     sizes;
+    size_t                min_blocks;
+    size_t                max_blocks;
+    double                size_alpha;
+    double                small_ratio;
+    lifetime_distribution lifetimes;
+    unsigned              flag_weights[4];  // relative weights of ALLOCATE_ANY, ALLOCATE_EXACT, ALLOCATE_ABOVE, ALLOCATE_BELOW
+    hint_distribution     hints;
+    size_t                operations;
+    size_t                report_interval;  // number of operations between two reports
+    unsigned              seed;
+};
+
+// Free space of an engine, measured between two batches of operations.
+struct free_space
+{
+    size_t span_count;
+    size_t free_bytes;
+    size_t largest_span;
+};
+
+// Measures the free space of an engine by walking its list of spans.
+// Engines with another structure provide their own overload.
+template <class Engine>
+void measure_free_space(const Engine& engine, free_space& space)
+{
+    space.span_count = 0;
+    space.free_bytes = 0;
+    space.largest_span = 0;
+    for (const span* s = engine.first_span(); s; s = s->next)
+    {
+        space.span_count++;
+        space.free_bytes += s->length;
+        if (s->length > space.largest_span) space.largest_span = s->length;
+    }
+}
+
+
+// Draws the requests of a workload.
+class workload_generator
+{
+public:
+    explicit workload_generator(const workload_config& config)
+        : _config(config), _random(config.seed), _unit(0.0, 1.0)
+        , _flags(config.flag_weights, config.flag_weights + 4)
+        , _hotspot((double)config.length / 2, (double)config.length / 16)
+    {}
+
+    size_t length()
+    {
+        size_t blocks = _config.min_blocks;
+        switch (_config.sizes)
+        {
+        case SIZE_UNIFORM:
+            blocks = _config.min_blocks + (size_t)(_unit(_random) * (_config.max_blocks - _config.min_blocks + 1));
+            break;
+        case SIZE_POWER_LAW:
+            blocks = (size_t)(_config.min_blocks / pow(1.0 - _unit(_random), 1.0 / _config.size_alpha));
+            break;
+        case SIZE_BIMODAL:
+            blocks = (_unit(_random) < _config.small_ratio) ? _config.min_blocks : _config.max_blocks;
+            break;
+        }
+        if (blocks > _config.max_blocks) blocks = _config.max_blocks;
+        return blocks * _config.granularity;
+    }
+
+    allocation_flags flags()
+    {
+        static const allocation_flags values[4] = { ALLOCATE_ANY, ALLOCATE_EXACT, ALLOCATE_ABOVE, ALLOCATE_BELOW };
+        return values[_flags(_random)];
+    }
+
+    // offset of the hint in the range, on the granularity
+    size_t hint()
+    {
+        double offset = (_config.hints == HINT_UNIFORM) ? _unit(_random) * _config.length : _hotspot(_random);
+        if (offset < 0) offset = 0;
+        if (offset >= (double)_config.length) offset = (double)(_config.length - 1);
+        return ((size_t)offset / _config.granularity) * _config.granularity;
+    }
+
+    // index of the range to release among <count> allocated ranges
+    size_t victim(size_t count)
+    {
+        switch (_config.lifetimes)
+        {
+        case LIFETIME_LIFO:
+            return count - 1;
+        case LIFETIME_FIFO:
+            return 0;
+        case LIFETIME_RANDOM:
+            break;
+        }
+        return (size_t)(_unit(_random) * count) % count;
+    }
+
+private:
+    workload_config                        _config;
+    std::mt19937_64                        _random;
+    std::uniform_real_distribution<double> _unit;
+    std::discrete_distribution<int>        _flags;
+    std::normal_distribution<double>       _hotspot;
+};
+
+
+// Runs a workload against an engine, and prints the throughput and the state of the free space at each
+// report interval. The time spent measuring the free space is not counted.
+template <class Engine>
+void run_workload(const char* engine_name, const workload_config& config)
+{
+    workload_generator generator(config);
+    Engine engine(bench_harness<Engine>::base, config.length, config.granularity);
+
+    std::deque<range> live;
+    size_t allocated_bytes = 0;
+    size_t failures = 0;
+    const size_t target = (size_t)(config.occupancy * config.length);
+
+    for (size_t done = 0; done < config.operations; )
+    {
+        size_t batch = config.report_interval;
+        if (batch > config.operations - done) batch = config.operations - done;
+
+        bench_timer timer;
+        for (size_t i = 0; i < batch; i++)
+        {
+            if (allocated_bytes < target || live.empty())
+            {
+                range r;
+                r.length = generator.length();
+                r.base = engine.allocate(r.length, generator.flags(), bench_harness<Engine>::base + generator.hint());
+                if (r.base != (vaddr_t)-1)
+                {
+                    live.push_back(r);
+                    allocated_bytes += r.length;
+                    continue;
+                }
+                failures++;
+                if (live.empty()) continue;
+            }
+
+            size_t victim = generator.victim(live.size());
+            range r = live[victim];
+            if (config.lifetimes == LIFETIME_FIFO)
+            {
+                live.pop_front();
+            }
+            else
+            {
+                live[victim] = live.back();
+                live.pop_back();
+            }
+            engine.free(r.base, r.length);
+            allocated_bytes -= r.length;
+        }
+        double ns = timer.elapsed_ns();
+        done += batch;
+
+        free_space space;
+        measure_free_space(engine, space);
+        double fragmentation = space.free_bytes ? 1.0 - (double)space.largest_span / space.free_bytes : 0.0;
+        printf("%-24s %-28s %10zu %12.0f %10zu %14zu %14zu %8.3f %10zu\n", engine_name, config.name, done,
+               batch / (ns * 1e-9), space.span_count, space.free_bytes, space.largest_span, fragmentation, failures);
+    }
+}
+
+// Prints the header of the table of workload results.
+inline void print_workload_header()
+{
+    printf("%-24s %-28s %10s %12s %10s %14s %14s %8s %10s\n", "engine", "workload", "operations", "ops/s",
+           "spans", "free bytes", "largest span", "frag", "failures");
+}
@@ -0,0 +1,206 @@
+#include "fcrangeallocator.h"
+
+#include <atomic>
+#include <thread>
+
+
+// Size of a cache line, used to keep the slots of different threads apart.
+const size_t cache_line_size = 64;
+
+enum fc_operation
+{
+    FC_ALLOCATE,
+    FC_FREE
+};
+
+enum fc_slot_state
+{
+    FC_SLOT_FREE,       // the slot can be claimed by a thread
+    FC_SLOT_CLAIMED,    // a thread is writing its request
+    FC_SLOT_PENDING,    // the request is published and waits for the combiner
+    FC_SLOT_DONE        // the request has been executed, the result is available
+};
+
+// A request published by a thread, alone on its cache line.
+struct alignas(cache_line_size) fc_slot
+{
+    std::atomic<int> state;
+    fc_operation     operation;
+    size_t           length;
+    allocation_flags flags;
+    vaddr_t          address;   // hint or base address of the request, then result of the allocation
+};
+
+
+class flat_combining_allocator
+{
+public:
+    static const size_t max_slots = 64;
+
+    // Takes the ownership of the range allocator
+    flat_combining_allocator(ralloc_t ralloc)
+        : _ralloc(ralloc), _combiner_busy(false)
+    {
+        for (size_t i = 0; i < max_slots; i++)
+        {
+            _slots[i].state.store(FC_SLOT_FREE, std::memory_order_relaxed);
+        }
+    }
+
+    ~flat_combining_allocator()
+    {
+        destroy_range_allocator(_ralloc);
+    }
+
+    // The slots must start on a cache line, which the global operator new does not guarantee before C++17.
+    // The address of the block that was allocated is stored just before the aligned instance.
+    static void* operator new(size_t size)
+    {
+        void* block = ::operator new(size + cache_line_size);
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(block) + cache_line_size) & ~(uintptr_t)(cache_line_size - 1);
+        reinterpret_cast<void**>(aligned)[-1] = block;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    static void operator delete(void* p)
+    {
+        ::operator delete(static_cast<void**>(p)[-1]);
+    }
+
+    vaddr_t allocate(size_t length, allocation_flags flags, vaddr_t hint)
+    {
+        return execute(FC_ALLOCATE, length, flags, hint);
+    }
+
+    void free(vaddr_t base, size_t length)
+    {
+        execute(FC_FREE, length, ALLOCATE_ANY, base);
+    }
+
+private:
+
+    // publish a request and wait for its completion, combining the pending requests if the lock is available
+    vaddr_t execute(fc_operation operation, size_t length, allocation_flags flags, vaddr_t address)
+    {
+        fc_slot* slot = claim_slot();
+        slot->operation = operation;
+        slot->length = length;
+        slot->flags = flags;
+        slot->address = address;
+        slot->state.store(FC_SLOT_PENDING, std::memory_order_release);
+
+        while (slot->state.load(std::memory_order_acquire) != FC_SLOT_DONE)
+        {
+            if (!_combiner_busy.load(std::memory_order_relaxed) && !_combiner_busy.exchange(true, std::memory_order_acquire))
+            {
+                combine();
+                _combiner_busy.store(false, std::memory_order_release);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        vaddr_t result = slot->address;
+        slot->state.store(FC_SLOT_FREE, std::memory_order_release);
+        return result;
+    }
+
+    // find a free slot, starting with the one preferred by the calling thread
+    fc_slot* claim_slot()
+    {
+        static std::atomic<size_t> next_thread_slot(0);
+        thread_local size_t preferred_slot = next_thread_slot.fetch_add(1, std::memory_order_relaxed) % max_slots;
+
+        for (;;)
+        {
+            for (size_t i = 0; i < max_slots; i++)
+            {
+                fc_slot* slot = &_slots[(preferred_slot + i) % max_slots];
+                int expected = FC_SLOT_FREE;
+                if (slot->state.load(std::memory_order_relaxed) == FC_SLOT_FREE &&
+                    slot->state.compare_exchange_strong(expected, FC_SLOT_CLAIMED, std::memory_order_acquire))
+                {
+                    return slot;
+                }
+            }
+            // more threads than slots: wait for a request to complete
+            std::this_thread::yield();
+        }
+    }
+
+    // execute all the pending requests, the combiner lock must be held
+    void combine()
+    {
+        // several passes to catch the requests published meanwhile
+        const int max_passes = 4;
+        for (int pass = 0; pass < max_passes; pass++)
+        {
+            bool found = false;
+            for (size_t i = 0; i < max_slots; i++)
+            {
+                fc_slot* slot = &_slots[i];
+                if (slot->state.load(std::memory_order_acquire) != FC_SLOT_PENDING)
+                    continue;
+
+                if (slot->operation == FC_ALLOCATE)
+                {
+                    slot->address = allocate_range(_ralloc, slot->length, slot->flags, slot->address);
+                }
+                else
+                {
+                    free_range(_ralloc, slot->address, slot->length);
+                }
+                slot->state.store(FC_SLOT_DONE, std::memory_order_release);
+                found = true;
+            }
+            if (!found) break;
+        }
+    }
+
+private:
+    ralloc_t          _ralloc;
+
+    // polled by all the waiting threads, on its own cache line
+    alignas(cache_line_size) std::atomic<bool> _combiner_busy;
+
+    fc_slot           _slots[max_slots];
+};
+
+
+
+fc_ralloc_t create_fc_range_allocator(vaddr_t base, size_t length, size_t granularity)
+{
+    ralloc_t ralloc = create_range_allocator(base, length, granularity);
+    if (!ralloc) return 0;
+
+    return new flat_combining_allocator(ralloc);
+}
+
+void destroy_fc_range_allocator(fc_ralloc_t ralloc)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+
+    delete static_cast<flat_combining_allocator*>(ralloc);
+}
+
+vaddr_t fc_allocate_range(fc_ralloc_t ralloc, size_t length, allocation_flags flags, vaddr_t optional_hint)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return (vaddr_t)-1;
+
+    return static_cast<flat_combining_allocator*>(ralloc)->allocate(length, flags, optional_hint);
+}
+
+void fc_free_range(fc_ralloc_t ralloc, vaddr_t base, size_t length)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+
+    static_cast<flat_combining_allocator*>(ralloc)->free(base, length);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "rangeallocator.h"
+
+
+// Flat-combining front end of the range allocator.
+// Threads publish their requests in per-thread slots, and the thread that gets the combiner lock executes all
+// the pending requests against the underlying range allocator, in one pass. The other threads just wait for
+// their result. This is thread-safe, and scales better than a mutex around the range allocator under contention:
+// the list of spans stays in the cache of the combiner and the lock is taken once for many operations.
+typedef void *fc_ralloc_t;
+
+// Creates a thread-safe range allocator representing the range [base, base + length).
+// Parameters are the same as create_range_allocator().
+fc_ralloc_t create_fc_range_allocator(vaddr_t base, size_t length, size_t granularity);
+
+// Frees all control structures associated with the specified range allocator.
+// No other thread must use the allocator at this time.
+void destroy_fc_range_allocator(fc_ralloc_t ralloc);
+
+// Same as allocate_range(), can be called from any thread.
+vaddr_t fc_allocate_range(fc_ralloc_t ralloc, size_t length, allocation_flags flags, vaddr_t optional_hint);
+
+// Same as free_range(), can be called from any thread.
+void fc_free_range(fc_ralloc_t ralloc, vaddr_t base, size_t length);
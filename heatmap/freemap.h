@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../rangeallocator.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+// Format of the files of successive free maps read by the heatmap tool: a header, followed by the maps returned by
+// export_range_allocator_free_map(), each one made of <bucket_count> bytes.
+const char     free_map_magic[4] = { 'R', 'A', 'F', 'M' };
+const uint32_t free_map_version = 1;
+
+struct free_map_header
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t bucket_count;
+    uint32_t reserved;
+};
+
+// Writes the header of a file of free maps. Returns false on error.
+inline bool write_free_map_header(FILE* f, size_t bucket_count)
+{
+    free_map_header header;
+    memcpy(header.magic, free_map_magic, sizeof(header.magic));
+    header.version = free_map_version;
+    header.bucket_count = (uint32_t)bucket_count;
+    header.reserved = 0;
+    return fwrite(&header, sizeof(header), 1, f) == 1;
+}
+
+// Appends the current free map of an allocator to a file, using map as a buffer of <bucket_count> bytes.
+// Returns false on error.
+inline bool write_free_map(FILE* f, ralloc_t ralloc, uint8_t* map, size_t bucket_count)
+{
+    export_range_allocator_free_map(ralloc, map, bucket_count);
+    return fwrite(map, 1, bucket_count, f) == bucket_count;
+}
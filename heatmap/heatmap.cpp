@@ -0,0 +1,74 @@
+#include "freemap.h"
+
+#include <stdlib.h>
+#include <vector>
+
+
+// Converts a file of successive free maps (see freemap.h) into a heatmap, in the binary PPM format: each map is a row
+// of the image, from the first snapshot at the top, each bucket a column. Allocated memory is red, free memory blue.
+// usage: heatmap <free maps> <image.ppm> [row height]
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        printf("usage: heatmap <free maps> <image.ppm> [row height]\n");
+        return 1;
+    }
+    size_t row_height = (argc > 3) ? strtoul(argv[3], 0, 10) : 1;
+    if (row_height == 0) row_height = 1;
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        printf("cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    free_map_header header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, free_map_magic, sizeof(header.magic)) != 0
+        || header.version != free_map_version || header.bucket_count == 0)
+    {
+        printf("%s is not a file of free maps\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+
+    // the maps are read once to count them, as the header of the image holds its height
+    std::vector<uint8_t> maps;
+    std::vector<uint8_t> map(header.bucket_count);
+    while (fread(&map[0], 1, map.size(), in) == map.size())
+    {
+        maps.insert(maps.end(), map.begin(), map.end());
+    }
+    fclose(in);
+
+    size_t rows = maps.size() / header.bucket_count;
+    FILE* out = fopen(argv[2], "wb");
+    if (!out)
+    {
+        printf("cannot create %s\n", argv[2]);
+        return 1;
+    }
+    fprintf(out, "P6\n%u %zu\n255\n", header.bucket_count, rows * row_height);
+
+    std::vector<uint8_t> pixels(3 * header.bucket_count);
+    for (size_t r = 0; r < rows; r++)
+    {
+        for (size_t i = 0; i < header.bucket_count; i++)
+        {
+            uint8_t free = maps[r * header.bucket_count + i];
+            pixels[3 * i] = (uint8_t)(255 - free);
+            pixels[3 * i + 1] = 0;
+            pixels[3 * i + 2] = free;
+        }
+        for (size_t h = 0; h < row_height; h++)
+        {
+            fwrite(&pixels[0], 1, pixels.size(), out);
+        }
+    }
+    fclose(out);
+
+    printf("%s: %zu maps of %u buckets\n", argv[2], rows, header.bucket_count);
+    return 0;
+}
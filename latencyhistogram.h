@@ -0,0 +1,144 @@
+#pragma once
+
+#include "rangeallocator.h"
+
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+// index of the highest bit set in a non-zero value
+inline size_t floor_log2(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(value >> 32))) return index + 32;
+    _BitScanReverse(&index, (unsigned long)value);
+    return index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+
+// Histogram of latencies in nanoseconds, with log-linear buckets: each power of two is split into
+// <sub_buckets> linear buckets, so that a value is known with a relative error below 1 / sub_buckets,
+// over the whole range of 64-bit values, in a fixed amount of memory.
+// Recording a value is a few arithmetic operations and an increment, without lock nor allocation.
+class latency_histogram
+{
+public:
+    static const size_t sub_bucket_bits = 2;
+    static const size_t sub_buckets = (size_t)1 << sub_bucket_bits;
+    static const size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    latency_histogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (size_t i = 0; i < bucket_count; i++)
+        {
+            _buckets[i] = 0;
+        }
+        _count = 0;
+        _max = 0;
+    }
+
+    void record(uint64_t ns)
+    {
+        _buckets[bucket_of(ns)]++;
+        _count++;
+        if (ns > _max) _max = ns;
+    }
+
+    uint64_t count() const
+    {
+        return _count;
+    }
+
+    uint64_t max() const
+    {
+        return _max;
+    }
+
+    // Returns the value below which a ratio <p> of the recorded values are, rounded up to the highest value
+    // of its bucket.
+    uint64_t percentile(double p) const
+    {
+        if (_count == 0) return 0;
+
+        uint64_t rank = (uint64_t)(p * _count);
+        if (rank >= _count) rank = _count - 1;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; i++)
+        {
+            seen += _buckets[i];
+            if (seen > rank)
+            {
+                uint64_t value = highest_of(i);
+                return value < _max ? value : _max;
+            }
+        }
+        return _max;
+    }
+
+private:
+    static size_t bucket_of(uint64_t value)
+    {
+        if (value < sub_buckets) return (size_t)value;
+
+        size_t exponent = floor_log2(value);
+
+        // the sub_bucket_bits bits that follow the highest bit set select the linear bucket
+        size_t shift = exponent - sub_bucket_bits;
+        return (exponent - sub_bucket_bits + 1) * sub_buckets + (size_t)((value >> shift) - sub_buckets);
+    }
+
+    static uint64_t highest_of(size_t bucket)
+    {
+        if (bucket < sub_buckets) return bucket;
+
+        size_t shift = bucket / sub_buckets - 1;
+        uint64_t lowest = (uint64_t)(sub_buckets + bucket % sub_buckets) << shift;
+        return lowest + ((uint64_t)1 << shift) - 1;
+    }
+
+    uint64_t _buckets[bucket_count];
+    uint64_t _count;
+    uint64_t _max;
+};
+
+
+// Records the duration of its scope into a histogram, if there is one.
+class operation_timer
+{
+public:
+    explicit operation_timer(latency_histogram* histogram)
+        : _histogram(histogram)
+    {
+        if (_histogram) _start = std::chrono::steady_clock::now();
+    }
+
+    ~operation_timer()
+    {
+        if (_histogram)
+        {
+            std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - _start;
+            _histogram->record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+private:
+    latency_histogram*                    _histogram;
+    std::chrono::steady_clock::time_point _start;
+};
@@ -1,5 +1,13 @@
 #include <iostream>
+#include <stdio.h>
+#include <thread>
+#include <vector>
 #include "rangeallocator.h"
+#include "fcrangeallocator.h"
+#include "numarangeallocator.h"
+#include "stripedrangeallocator.h"
+#include "rangeallocatortrace.h"
+#include "spanmanager.h"
 
 #define TEST(msg)            std::cout << "[line " << __LINE__ << "] " << msg << ": ";
 #define CHECK(expr)          std::cout << (!(expr) ? "FAILED" : "OK") << std::endl;
@@ -8,6 +16,8 @@ int main(int, char*[])
 {
     ralloc_t ra = 0;
     vaddr_t mem = 0;
+    vaddr_t mem1 = 0;
+    vaddr_t mem2 = 0;
 
     const vaddr_t base        = 0x1000;
     const size_t  length      = 4096;
@@ -158,5 +168,702 @@ int main(int, char*[])
 
 
 
+    // Deferred free
+    set_range_allocator_deferred_free(ra, 1);
+
+    TEST("Ranges freed in deferred mode should be merged by the next allocation");
+    for (size_t i = 0; i < length / granularity; i++)
+        allocate_range(ra, granularity, ALLOCATE_EXACT, base + i * granularity);
+    for (size_t i = 0; i < length / granularity; i += 2)
+        free_range(ra, base + i * granularity, granularity);                                // |-_-_-_-_-_-_-_-_-_-_-_-_-_-_-_|
+    for (size_t i = 1; i < length / granularity; i += 2)
+        free_range(ra, base + i * granularity, granularity);                                // |-------------------------------|
+    mem = allocate_range(ra, length, ALLOCATE_ANY, 0);
+    CHECK(mem == base);
+
+    TEST("Ranges freed concurrently in deferred mode should all be merged");
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++) {
+        threads.push_back(std::thread([=]() {
+            for (size_t i = t; i < length / granularity; i += 4)
+                free_range(ra, base + i * granularity, granularity);
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    flush_range_allocator(ra);
+    mem = allocate_range(ra, length, ALLOCATE_EXACT, base);
+    CHECK(mem == base);
+
+    TEST("Disabling the deferred free mode should merge the queued ranges");
+    free_range(ra, base, length);
+    set_range_allocator_deferred_free(ra, 0);
+    mem = allocate_range(ra, length, ALLOCATE_EXACT, base);
+    CHECK(mem == base);
+
+    free_range(ra, base, length);
+
+    TEST("Ranges freed in deferred mode beyond the capacity of the queue should all be merged");
+    ralloc_t big = create_range_allocator(base, 8192 * granularity, granularity);
+    std::vector<vaddr_t> queued(8192);
+    allocate_ranges(big, granularity, queued.size(), ALLOCATE_ANY, 0, &queued[0]);
+    set_range_allocator_deferred_free(big, 1);
+    for (size_t i = 0; i < queued.size(); i += 2)
+        free_range(big, queued[i], granularity);
+    for (size_t i = 1; i < queued.size(); i += 2)
+        free_range(big, queued[i], granularity);
+    mem = allocate_range(big, 8192 * granularity, ALLOCATE_EXACT, base);
+    CHECK(mem == base);
+
+    TEST("A thread should merge the full queue itself while the allocating thread is idle");
+    free_range(big, base, 8192 * granularity);
+    allocate_ranges(big, granularity, queued.size(), ALLOCATE_ANY, 0, &queued[0]);
+    std::thread producer([&]() {
+        for (size_t i = 0; i < queued.size(); i += 2)
+            free_range(big, queued[i], granularity);
+        for (size_t i = 1; i < queued.size(); i += 2)
+            free_range(big, queued[i], granularity);
+    });
+    producer.join();
+    mem = allocate_range(big, 8192 * granularity, ALLOCATE_EXACT, base);
+    CHECK(mem == base);
+    destroy_range_allocator(big);
+
+
+
+    // Batch allocation
+    vaddr_t bases[length / granularity + 1];
+
+    TEST("allocate_ranges should carve consecutive ranges from the same block");
+    size_t count = allocate_ranges(ra, granularity, 8, ALLOCATE_ANY, 0, bases);
+    failed = (count != 8);
+    for (size_t i = 0; !failed && i < count; i++)
+        failed = (bases[i] != base + i * granularity);
+    CHECK(!failed);
+
+    TEST("allocate_ranges should continue with the next blocks");
+    free_range(ra, base + granularity, granularity);                                        // |-^------'---------------------|
+    count = allocate_ranges(ra, 2 * granularity, 4, ALLOCATE_ANY, 0, bases);
+    CHECK(count == 4 && bases[0] == base + 8 * granularity && bases[3] == base + 14 * granularity);
+
+    free_range(ra, base, granularity);
+    free_range(ra, base + 2 * granularity, 14 * granularity);
+
+    TEST("allocate_ranges should return the number of ranges it could allocate");
+    count = allocate_ranges(ra, granularity, length / granularity + 1, ALLOCATE_ANY, 0, bases);
+    CHECK(count == length / granularity);
+
+    free_range(ra, base, length);
+
+    TEST("allocate_ranges with ALLOCATE_BELOW must only return ranges below the hint");
+    count = allocate_ranges(ra, 3 * granularity, length / granularity, ALLOCATE_BELOW, hint, bases);
+    CHECK(count == (length / 2) / (3 * granularity) && bases[count - 1] + 3 * granularity <= hint);
+
+    free_range(ra, base, length / 2);
+
+    TEST("allocate_ranges with ALLOCATE_EXACT should return consecutive ranges at the hint");
+    count = allocate_ranges(ra, granularity, 4, ALLOCATE_EXACT, hint, bases);
+    CHECK(count == 4 && bases[0] == hint && bases[3] == hint + 3 * granularity);
+
+    free_range(ra, hint, 4 * granularity);
+
+
+
+    // Batch free
+    range ranges[length / granularity];
+
+    TEST("Ranges released with free_ranges should all be merged, whatever their order");
+    allocate_range(ra, length, ALLOCATE_ANY, 0);
+    for (size_t i = 0; i < length / granularity; i++) {
+        ranges[i].base = base + ((i * 7) % (length / granularity)) * granularity;
+        ranges[i].length = granularity;
+    }
+    free_ranges(ra, ranges, length / granularity);
+    mem = allocate_range(ra, length, ALLOCATE_ANY, 0);
+    CHECK(mem == base);
+
+    TEST("free_ranges must ignore a range that overlaps a free block");
+    ranges[0].base = base;          ranges[0].length = 4 * granularity;
+    ranges[1].base = hint;          ranges[1].length = 2 * granularity;
+    ranges[2].base = base + 2 * granularity; ranges[2].length = 4 * granularity;            // overlaps ranges[0]
+    free_ranges(ra, ranges, 3);
+    mem1 = allocate_range(ra, 4 * granularity, ALLOCATE_EXACT, base);
+    mem2 = allocate_range(ra, 2 * granularity, ALLOCATE_EXACT, hint);
+    mem = allocate_range(ra, granularity, ALLOCATE_ANY, 0);
+    CHECK(mem1 == base && mem2 == hint && mem == invalid);
+
+    free_range(ra, base, length);
+
+
+
+    // Aligned allocation
+    const size_t alignment = 16 * granularity;
+
+    TEST("Aligned allocation with an alignment that is not a multiple of the granularity must fail");
+    mem = allocate_range_aligned(ra, granularity, granularity + granularity / 2, ALLOCATE_ANY, 0);
+    CHECK(mem == invalid);
+
+    TEST("ALLOCATE_ANY with alignment should return an aligned address");
+    allocate_range(ra, granularity, ALLOCATE_ANY, 0);                                       // |^------------------------------|
+    mem = allocate_range_aligned(ra, granularity, alignment, ALLOCATE_ANY, 0);              // |_---------------^--------------|
+    CHECK(mem == base + alignment);
+
+    TEST("The slack before an aligned range should stay available");
+    mem = allocate_range(ra, alignment - granularity, ALLOCATE_EXACT, base + granularity);  // |_^^^^^^^^^^^^^^_--------------|
+    CHECK(mem == base + granularity);
+
+    TEST("ALLOCATE_ABOVE with alignment should return the highest aligned address");
+    mem = allocate_range_aligned(ra, 4 * granularity, alignment, ALLOCATE_ABOVE, hint);     // |________________-----------^^^^|
+    CHECK(mem == base + length - alignment);
+
+    TEST("ALLOCATE_BELOW with alignment must fail when no aligned range fits below the hint");
+    mem = allocate_range_aligned(ra, 2 * granularity, alignment, ALLOCATE_BELOW, hint);
+    CHECK(mem == invalid);
+
+    free_range(ra, base, alignment + granularity);
+    free_range(ra, base + length - alignment, 4 * granularity);
+
+
+
+    // ALLOCATE_NEAR
+    TEST("Trying to ALLOCATE_NEAR with null length must fail");
+    mem = allocate_range(ra, 0, ALLOCATE_NEAR, hint);
+    CHECK(mem == invalid);
+
+    TEST("ALLOCATE_NEAR should return the hint when it is free");
+    mem = allocate_range(ra, granularity, ALLOCATE_NEAR, hint);                             // |----------------'-------------|
+    CHECK(mem == hint);                                                                     //                  ^              
+
+    free_range(ra, hint, granularity);
+
+    TEST("ALLOCATE_NEAR should return the closest free address, on either side of the hint");
+    allocate_range(ra, length, ALLOCATE_ANY, 0);
+    free_range(ra, base + 2 * granularity, granularity);
+    free_range(ra, base + length - 4 * granularity, 2 * granularity);                       // |__-_____________'_________--__|
+    mem1 = allocate_range(ra, granularity, ALLOCATE_NEAR, hint);                            //                            ^    
+    mem2 = allocate_range(ra, granularity, ALLOCATE_NEAR, hint - length / 4);               //    ^                            
+    CHECK(mem1 == base + length - 4 * granularity && mem2 == base + 2 * granularity);
+
+    TEST("ALLOCATE_NEAR must fail when no block is large enough");
+    mem = allocate_range(ra, 2 * granularity, ALLOCATE_NEAR, hint);
+    CHECK(mem == invalid);
+
+    free_range(ra, base, length - 3 * granularity);
+    free_range(ra, base + length - 2 * granularity, 2 * granularity);
+
+    TEST("allocate_ranges with ALLOCATE_NEAR should place each range as close to the hint as possible");
+    allocate_range(ra, granularity, ALLOCATE_EXACT, base + 11 * granularity);
+    allocate_range(ra, length - 18 * granularity, ALLOCATE_EXACT, base + 18 * granularity); // |----------------------_------______|
+    count = allocate_ranges(ra, 3 * granularity, 5, ALLOCATE_NEAR, base + granularity, bases);
+    mem1 = allocate_range(ra, granularity, ALLOCATE_EXACT, base);
+    mem2 = allocate_range(ra, granularity, ALLOCATE_EXACT, base + 10 * granularity);
+    CHECK(count == 5 && bases[0] == base + granularity && bases[2] == base + 7 * granularity &&
+          bases[3] == base + 12 * granularity && bases[4] == base + 15 * granularity && mem1 == base && mem2 == base + 10 * granularity);
+
+    free_range(ra, base, length);
+
+
+
+    // Hint-local placement
+    set_range_allocator_placement(ra, PLACEMENT_HINT_LOCAL);
+
+    TEST("With hint-local placement, ALLOCATE_ABOVE should return the lowest address above the hint");
+    mem = allocate_range(ra, 4 * granularity, ALLOCATE_ABOVE, hint);                        // |----------------'-------------|
+    CHECK(mem == hint);                                                                     //                  ^^^^           
+
+    TEST("With hint-local placement, ALLOCATE_BELOW should return the highest range below the hint");
+    mem = allocate_range(ra, 4 * granularity, ALLOCATE_BELOW, hint);                        // |----------------'____---------|
+    CHECK(mem == hint - 4 * granularity);                                                   //              ^^^^               
+
+    TEST("With hint-local placement, ALLOCATE_BELOW should skip the blocks too small below the hint");
+    allocate_range(ra, 2 * granularity, ALLOCATE_EXACT, hint - 7 * granularity);            // |---------___-____'____---------|
+    mem = allocate_range(ra, 2 * granularity, ALLOCATE_BELOW, hint);                        //        ^^                        
+    CHECK(mem == hint - 9 * granularity);
+
+    free_range(ra, hint - 9 * granularity, 4 * granularity);
+    free_range(ra, hint - 4 * granularity, 8 * granularity);
+
+    TEST("With hint-local placement, allocate_ranges should keep the upper part of a split block when it spills into the next one");
+    allocate_range(ra, granularity, ALLOCATE_EXACT, base + 6 * granularity);
+    allocate_range(ra, length - 9 * granularity, ALLOCATE_EXACT, base + 9 * granularity);  // |------_--______________________|
+    count = allocate_ranges(ra, 2 * granularity, 3, ALLOCATE_ABOVE, base + granularity, bases);
+    mem1 = allocate_range(ra, granularity, ALLOCATE_EXACT, base);
+    mem2 = allocate_range(ra, granularity, ALLOCATE_EXACT, base + 5 * granularity);
+    CHECK(count == 3 && bases[0] == base + granularity && bases[1] == base + 3 * granularity && bases[2] == base + 7 * granularity &&
+          mem1 == base && mem2 == base + 5 * granularity);
+
+    free_range(ra, base, length);
+
+    TEST("With hint-local placement, allocate_ranges with ALLOCATE_BELOW should carve the ranges down from the hint");
+    allocate_range(ra, granularity, ALLOCATE_EXACT, hint - 3 * granularity);                // |-------------_--'-------------|
+    count = allocate_ranges(ra, 2 * granularity, 2, ALLOCATE_BELOW, hint, bases);            //        ^^^^^^ ^^
+    CHECK(count == 2 && bases[0] == hint - 2 * granularity && bases[1] == hint - 5 * granularity);
+
+    free_range(ra, hint - 5 * granularity, 5 * granularity);
+    set_range_allocator_placement(ra, PLACEMENT_DEFAULT);
+
+    TEST("Should be able to ALLOCATE_ANY the full memory");
+    mem = allocate_range(ra, length, ALLOCATE_ANY, 0);
+    CHECK(mem == base);
+
+    free_range(ra, base, length);
+
+
+
+    // Bounded window
+    TEST("Trying to allocate in a window smaller than the length must fail");
+    mem = allocate_range_between(ra, 4 * granularity, hint, hint + 3 * granularity);
+    CHECK(mem == invalid);
+
+    TEST("Allocation in a window should return the lowest free address of the window");
+    mem = allocate_range_between(ra, 4 * granularity, hint, hint + 8 * granularity);        // |----------------'^^^^----'----|
+    CHECK(mem == hint);
+
+    TEST("Allocation in a window should skip the blocks too small in the window");
+    allocate_range(ra, granularity, ALLOCATE_EXACT, hint + 6 * granularity);                // |----------------'____--_-'----|
+    mem = allocate_range_between(ra, granularity, hint + granularity, hint + 8 * granularity);
+    CHECK(mem == hint + 4 * granularity);                                                   //                      ^
+
+    TEST("Allocation in a window must fail when the free blocks of the window are too small");
+    mem = allocate_range_between(ra, 2 * granularity, hint, hint + 8 * granularity);        // |----------------'_____-_-'----|
+    CHECK(mem == invalid);
+
+    free_range(ra, hint, 5 * granularity);
+    free_range(ra, hint + 6 * granularity, granularity);
+
+
+
+    // In-place resize
+    TEST("A range should grow in place into the following free block");
+    mem = allocate_range(ra, 2 * granularity, ALLOCATE_EXACT, hint);                        // |----------------'^^-----------|
+    mem = resize_range(ra, hint, 2 * granularity, 4 * granularity);                         // |----------------'^^^^---------|
+    CHECK(mem == hint);
+
+    TEST("Trying to grow a range over an allocated block must fail");
+    allocate_range(ra, granularity, ALLOCATE_EXACT, hint + 5 * granularity);                // |----------------'____-_-------|
+    mem = resize_range(ra, hint, 4 * granularity, 6 * granularity);                         //                       ^^
+    CHECK(mem == invalid);
+
+    TEST("A range should grow in place up to the next allocated block");
+    mem = resize_range(ra, hint, 4 * granularity, 5 * granularity);                         // |----------------'_____-_------|
+    CHECK(mem == hint);
+
+    TEST("The tail of a shrunk range should be available again");
+    resize_range(ra, hint, 5 * granularity, granularity);                                   // |----------------'_^^^^_-------|
+    mem = allocate_range(ra, 4 * granularity, ALLOCATE_EXACT, hint + granularity);
+    CHECK(mem == hint + granularity);
+
+    free_range(ra, hint, 6 * granularity);
+
+
+
+    // Reset
+    TEST("After a reset, the full memory should be available again");
+    for (size_t i = 0; i < length / granularity; i += 2)
+        allocate_range(ra, granularity, ALLOCATE_EXACT, base + i * granularity);            // |_-_-_-_-_-_-_-_-_-_-_-_-_-_-_-|
+    reset_range_allocator(ra);
+    mem = allocate_range(ra, length, ALLOCATE_ANY, 0);
+    CHECK(mem == base);
+
+    TEST("After a reset, the memory can be fragmented again");
+    reset_range_allocator(ra);
+    failed = false;
+    for (size_t i = 1; !failed && i < length / granularity; i += 2)
+        failed = (allocate_range(ra, granularity, ALLOCATE_EXACT, base + i * granularity) == invalid);
+    CHECK(!failed);
+
+    reset_range_allocator(ra);
+
+
+    // Regions
+    TEST("A region overlapping the managed range should be rejected");
+    CHECK(range_allocator_add_region(ra, base + length - granularity, 2 * granularity) == 0);
+
+    TEST("A region off the granularity grid should be rejected");
+    CHECK(range_allocator_add_region(ra, 0x4000 + 1, 4 * granularity) == 0);
+
+    TEST("A disjoint region should provide memory once the first one is exhausted");
+    mem = allocate_range(ra, length, ALLOCATE_ANY, 0);
+    CHECK(mem == base && range_allocator_add_region(ra, 0x4000, 4 * granularity) != 0 && allocate_range(ra, 2 * granularity, ALLOCATE_ANY, 0) == 0x4000);
+
+    TEST("An allocation should not span two adjacent regions");
+    reset_range_allocator(ra);
+    range_allocator_add_region(ra, base + length, 4 * granularity);
+    allocate_range(ra, length - granularity, ALLOCATE_EXACT, base);                           // |----------------------------_| |____|
+    CHECK(allocate_range(ra, 2 * granularity, ALLOCATE_EXACT, base + length - granularity) == invalid);
+
+    TEST("Ranges freed on both sides of the boundary of adjacent regions should not be merged");
+    mem1 = allocate_range(ra, granularity, ALLOCATE_EXACT, base + length - granularity);
+    mem2 = allocate_range(ra, 4 * granularity, ALLOCATE_EXACT, base + length);               // |-----------------------------| |----|
+    free_range(ra, mem1, granularity);
+    free_range(ra, mem2, 4 * granularity);                                                    // |----------------------------_| |____|
+    CHECK(allocate_range(ra, 2 * granularity, ALLOCATE_EXACT, base + length - granularity) == invalid);
+
+    TEST("A range should not grow into an adjacent region");
+    reset_range_allocator(ra);
+    mem = allocate_range(ra, length, ALLOCATE_EXACT, base);                                   // |-----------------------------| |____|
+    CHECK(resize_range(ra, mem, length, length + 2 * granularity) == invalid && allocate_range(ra, 4 * granularity, ALLOCATE_EXACT, base + length) == base + length);
+
+    reset_range_allocator(ra);
+
+    destroy_range_allocator(ra);
+    ra = create_range_allocator(base, length, granularity);
+
+    // Extension
+    TEST("The tail added by an extension should be merged with the last free span");
+    allocate_range(ra, length - granularity, ALLOCATE_EXACT, base);                           // |----------------------------_|
+    extend_range_allocator(ra, 2 * granularity);                                              // |----------------------------___|
+    mem = allocate_range(ra, 3 * granularity, ALLOCATE_ANY, 0);
+    CHECK(mem == base + length - granularity);
+
+    TEST("An extension should provide memory after the full range is allocated");
+    CHECK(extend_range_allocator(ra, granularity) != 0 && allocate_range(ra, granularity, ALLOCATE_ANY, 0) == base + length + 2 * granularity);
+
+    TEST("The extended range should be freed as a whole");
+    free_range(ra, base, length + 3 * granularity);
+    mem = allocate_range(ra, length + 3 * granularity, ALLOCATE_ANY, 0);
+    CHECK(mem == base);
+
+    TEST("An extension overlapping a region should be rejected");
+    range_allocator_add_region(ra, base + length + 4 * granularity, 4 * granularity);
+    CHECK(extend_range_allocator(ra, 2 * granularity) == 0 && extend_range_allocator(ra, granularity) != 0);
+
+    reset_range_allocator(ra);
+
+
+
+    destroy_range_allocator(ra);
+
+
+
+    // Trace
+    TEST("A trace should record the calls made on the allocators created while it is active");
+    start_range_allocator_trace("rangeallocator.trace");
+    ra = create_range_allocator(base, length, granularity);
+    mem = allocate_range(ra, 2 * granularity, ALLOCATE_ANY, 0);
+    free_range(ra, mem, 2 * granularity);
+    destroy_range_allocator(ra);
+    stop_range_allocator_trace();
+    std::vector<trace_record> records;
+    FILE* trace = fopen("rangeallocator.trace", "rb");
+    trace_header header;
+    trace_record record;
+    if (trace && fread(&header, sizeof(header), 1, trace) == 1)
+        while (fread(&record, sizeof(record), 1, trace) == 1)
+            records.push_back(record);
+    if (trace) fclose(trace);
+    remove("rangeallocator.trace");
+    CHECK(records.size() == 4 && records[0].operation == TRACE_CREATE && records[1].operation == TRACE_ALLOCATE && records[1].result == mem
+          && records[2].operation == TRACE_FREE && records[3].operation == TRACE_DESTROY);
+
+
+
+    // Stats
+    ra = create_range_allocator(base, length, granularity);
+    mem = allocate_range(ra, 2 * granularity, ALLOCATE_ANY, 0);                              // |--____________________________|
+    allocate_range(ra, granularity, ALLOCATE_EXACT, mem);
+    mem1 = allocate_range(ra, 2 * granularity, ALLOCATE_ABOVE, hint);                         // |--__________________________--|
+    range_allocator_stats stats;
+    get_range_allocator_stats(ra, &stats);
+
+#if !defined(RANGE_ALLOCATOR_NO_STATS)
+    TEST("The stats should count the allocations and failures per flag");
+    CHECK(stats.allocations[ALLOCATE_ANY] == 1 && stats.allocation_failures[ALLOCATE_EXACT] == 1 && stats.allocations[ALLOCATE_ABOVE] == 1);
+#endif
+
+    TEST("The stats should describe the free space");
+    CHECK(stats.span_count == 1 && stats.free_bytes == length - 4 * granularity && stats.largest_free_span == length - 4 * granularity);
+
+    free_range(ra, mem, 2 * granularity);                                                     // |______________________________--|
+    get_range_allocator_stats(ra, &stats);
+#if !defined(RANGE_ALLOCATOR_NO_STATS)
+    TEST("The stats should count the spans visited by each operation");
+    CHECK(stats.frees == 1 && stats.visited_spans[0] + stats.visited_spans[1] + stats.visited_spans[2] == 4);
+#endif
+
+    allocate_range(ra, granularity, ALLOCATE_EXACT, base + granularity);                      // |_-____________________________--|
+    free_range(ra, base + granularity, granularity);
+    get_range_allocator_stats(ra, &stats);
+#if !defined(RANGE_ALLOCATOR_NO_STATS)
+    TEST("The stats should report the high-water mark of the span pool");
+    CHECK(stats.span_pool_high_water == 2 && stats.span_count == 1);
+#endif
+
+    allocate_ranges(ra, granularity, 3, ALLOCATE_ANY, 0, bases);
+    resize_range(ra, bases[2], granularity, 2 * granularity);
+    allocate_range_between(ra, granularity, base, hint);                                      // |-----_______________________--|
+    range_allocator_stats batch_stats;
+    get_range_allocator_stats(ra, &batch_stats);
+#if !defined(RANGE_ALLOCATOR_NO_STATS)
+    TEST("The stats should count the ranges of a batch, the windowed allocations and the growths");
+    size_t operations = 0;
+    for (size_t i = 0; i < RANGE_ALLOCATOR_VISIT_BUCKETS; i++)
+        operations += batch_stats.visited_spans[i] - stats.visited_spans[i];
+    CHECK(batch_stats.allocations[ALLOCATE_ANY] == stats.allocations[ALLOCATE_ANY] + 4
+          && batch_stats.allocations[ALLOCATE_EXACT] == stats.allocations[ALLOCATE_EXACT] + 1 && operations == 3);
+#endif
+
+    destroy_range_allocator(ra);
+
+
+
+    // Fragmentation
+    ra = create_range_allocator(base, length, granularity);
+    range_allocator_fragmentation fragmentation;
+
+    TEST("A new allocator should have a single free span and no fragmentation");
+    get_range_allocator_fragmentation(ra, &fragmentation);
+    CHECK(fragmentation.free_bytes == length && fragmentation.largest_free_span == length && fragmentation.span_count == 1
+          && fragmentation.spans_by_size[12] == 1 && fragmentation.ratio == 0.0);
+
+    TEST("The fragmentation metrics should follow a split");
+    allocate_range(ra, granularity, ALLOCATE_EXACT, hint);                                    // |_______________-______________|
+    get_range_allocator_fragmentation(ra, &fragmentation);
+    CHECK(fragmentation.free_bytes == length - granularity && fragmentation.largest_free_span == length / 2 && fragmentation.span_count == 2
+          && fragmentation.spans_by_size[11] == 1 && fragmentation.spans_by_size[10] == 1 && fragmentation.spans_by_size[12] == 0
+          && fragmentation.ratio > 0.49 && fragmentation.ratio < 0.5);
+
+    TEST("The largest free span should be updated when it is allocated");
+    allocate_range(ra, length / 2, ALLOCATE_EXACT, base);                                     // |----------------______________|
+    get_range_allocator_fragmentation(ra, &fragmentation);
+    CHECK(fragmentation.largest_free_span == length / 2 - granularity && fragmentation.span_count == 1 && fragmentation.ratio == 0.0);
+
+    TEST("The fragmentation metrics should follow the merges");
+    free_range(ra, base, length / 2 + granularity);                                          // |______________________________|
+    get_range_allocator_fragmentation(ra, &fragmentation);
+    CHECK(fragmentation.free_bytes == length && fragmentation.largest_free_span == length && fragmentation.span_count == 1);
+
+    TEST("The largest free span should be kept when another span of the same length shrinks");
+    allocate_range(ra, 2 * granularity, ALLOCATE_EXACT, hint - granularity);                  // |______________--______________|
+    allocate_range(ra, granularity, ALLOCATE_EXACT, base + length - granularity);            // |______________--_____________-|
+    get_range_allocator_fragmentation(ra, &fragmentation);
+    CHECK(fragmentation.largest_free_span == length / 2 - granularity && fragmentation.span_count == 2);
+
+    destroy_range_allocator(ra);
+
+
+
+    // Latency
+    ra = create_range_allocator(base, length, granularity);
+    range_allocator_latency latency;
+
+    TEST("The latencies should not be available until the timing is enabled");
+    CHECK(get_range_allocator_latency(ra, ALLOCATE_ANY, &latency) == 0);
+
+    TEST("The latencies should be recorded per allocation flag and for the releases");
+    set_range_allocator_latency_tracking(ra, 1);
+    for (size_t i = 0; i < 100; i++)
+        free_range(ra, allocate_range(ra, granularity, ALLOCATE_ANY, 0), granularity);
+    allocate_range(ra, granularity, ALLOCATE_NEAR, hint);
+    get_range_allocator_latency(ra, ALLOCATE_ANY, &latency);
+    failed = (latency.count != 100 || latency.p50 > latency.p99 || latency.p99 > latency.max);
+    get_range_allocator_latency(ra, RANGE_ALLOCATOR_LATENCY_FREE, &latency);
+    failed = failed || latency.count != 100;
+    get_range_allocator_latency(ra, ALLOCATE_NEAR, &latency);
+    CHECK(!failed && latency.count == 1 && get_range_allocator_latency(ra, RANGE_ALLOCATOR_LATENCY_FREE + 1, &latency) == 0);
+
+    TEST("Resetting the latencies should clear the histograms");
+    reset_range_allocator_latency(ra);
+    get_range_allocator_latency(ra, ALLOCATE_ANY, &latency);
+    CHECK(latency.count == 0 && latency.max == 0);
+
+    destroy_range_allocator(ra);
+
+
+
+    // Free space export
+    ra = create_range_allocator(base, length, granularity);
+    allocate_range(ra, length / 4, ALLOCATE_EXACT, base);                                     // |--------______________________|
+    allocate_range(ra, length / 8, ALLOCATE_EXACT, hint);                                     // |--------_______----___________|
+
+    TEST("The export of the spans should visit each free span in order");
+    std::vector<range> exported;
+    export_range_allocator_spans(ra, [](void* context, vaddr_t b, size_t l) {
+        range r = { b, l };
+        static_cast<std::vector<range>*>(context)->push_back(r);
+    }, &exported);
+    CHECK(exported.size() == 2 && exported[0].base == base + length / 4 && exported[0].length == length / 4
+          && exported[1].base == hint + length / 8 && exported[1].length == length * 3 / 8);
+
+    TEST("The free map should give the ratio of free memory per window");
+    uint8_t map[8];
+    export_range_allocator_free_map(ra, map, 8);
+    CHECK(map[0] == 0 && map[1] == 0 && map[2] == 255 && map[3] == 255 && map[4] == 0 && map[5] == 255 && map[7] == 255);
+
+    TEST("The free map should round the partial windows");
+    export_range_allocator_free_map(ra, map, 3);                                              // |---------|---------|----------|
+    CHECK(map[0] == 64 && map[2] == 255);
+
     destroy_range_allocator(ra);
+
+
+
+    // Flat combining
+    fc_ralloc_t fcra = create_fc_range_allocator(base, length, granularity);
+
+    TEST("Each memory block should be allocated exactly once by concurrent threads");
+    std::vector<vaddr_t> blocks[4];
+    threads.clear();
+    for (size_t t = 0; t < 4; t++) {
+        std::vector<vaddr_t>* result = &blocks[t];
+        threads.push_back(std::thread([=]() {
+            for (vaddr_t m = fc_allocate_range(fcra, granularity, ALLOCATE_ANY, 0); m != invalid; m = fc_allocate_range(fcra, granularity, ALLOCATE_ANY, 0))
+                result->push_back(m);
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    std::vector<bool> used(length / granularity, false);
+    failed = false;
+    for (size_t t = 0; t < 4; t++) {
+        for (size_t i = 0; i < blocks[t].size(); i++) {
+            size_t index = (blocks[t][i] - base) / granularity;
+            failed = failed || used[index];
+            used[index] = true;
+        }
+    }
+    for (size_t i = 0; i < used.size(); i++)
+        failed = failed || !used[i];
+    CHECK(!failed);
+
+    TEST("Blocks freed by concurrent threads should all be merged");
+    threads.clear();
+    for (size_t t = 0; t < 4; t++) {
+        std::vector<vaddr_t>* result = &blocks[t];
+        threads.push_back(std::thread([=]() {
+            for (size_t i = 0; i < result->size(); i++)
+                fc_free_range(fcra, (*result)[i], granularity);
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    mem = fc_allocate_range(fcra, length, ALLOCATE_ANY, 0);
+    CHECK(mem == base);
+
+    destroy_fc_range_allocator(fcra);
+
+
+
+    // Epoch-based reclamation of spans
+    span_manager_epoch<span_manager_allocate> epoch_spans(0);
+    size_t reader = epoch_spans.register_reader();
+
+    TEST("A span released while a reader is active must not be recycled");
+    span* s1 = epoch_spans.get();
+    span* s2 = 0;
+    {
+        epoch_guard<span_manager_allocate> guard(epoch_spans, reader);
+        epoch_spans.release(s1);
+        epoch_spans.reclaim();
+        epoch_spans.reclaim();
+        s2 = epoch_spans.get();
+    }
+    CHECK(s2 != s1);
+
+    TEST("A span released during a read should be recycled once the readers have advanced");
+    epoch_spans.reclaim();
+    epoch_spans.reclaim();
+    span* s3 = epoch_spans.get();
+    CHECK(s3 == s1);
+
+    TEST("A released span should keep its link to the next span for the readers standing on it");
+    s3->next = s2;
+    epoch_spans.release(s3);
+    CHECK(s3->next == s2);
+
+    epoch_spans.release(s2);
+    epoch_spans.unregister_reader(reader);
+
+
+
+    // NUMA-aware allocator
+    numa_ralloc_t nra = create_numa_range_allocator(base, length, granularity, 0);
+
+    TEST("NUMA allocator should work with the nodes of the system");
+    mem = numa_allocate_range(nra, granularity, ALLOCATE_ANY, 0);
+    CHECK(mem != invalid);
+
+    numa_free_range(nra, mem, granularity);
+    destroy_numa_range_allocator(nra);
+
+    nra = create_numa_range_allocator(base, length, granularity, 2);
+
+    TEST("Each node should serve an allocation of its whole sub-range");
+    mem1 = numa_allocate_range(nra, length / 2, ALLOCATE_ANY, 0);
+    mem2 = numa_allocate_range(nra, length / 2, ALLOCATE_ANY, 0);
+    CHECK(mem1 != invalid && mem2 != invalid && mem1 != mem2);
+
+    TEST("Trying to allocate when all nodes are full must fail");
+    mem = numa_allocate_range(nra, granularity, ALLOCATE_ANY, 0);
+    CHECK(mem == invalid);
+
+    numa_free_range(nra, base, length);
+
+    TEST("ALLOCATE_EXACT should succeed across the sub-ranges of two nodes");
+    mem = numa_allocate_range(nra, 2 * granularity, ALLOCATE_EXACT, hint - granularity);
+    CHECK(mem == hint - granularity);
+
+    numa_free_range(nra, hint - granularity, 2 * granularity);
+
+    TEST("Trying to ALLOCATE_EXACT across nodes with overlap must fail");
+    numa_allocate_range(nra, granularity, ALLOCATE_EXACT, hint + granularity);
+    mem = numa_allocate_range(nra, 4 * granularity, ALLOCATE_EXACT, hint - 2 * granularity);
+    CHECK(mem == invalid);
+
+    numa_free_range(nra, hint + granularity, granularity);
+
+    TEST("A failed ALLOCATE_EXACT across nodes must not leak the parts already allocated");
+    mem1 = numa_allocate_range(nra, length / 2, ALLOCATE_EXACT, base);
+    mem2 = numa_allocate_range(nra, length / 2, ALLOCATE_EXACT, hint);
+    CHECK(mem1 == base && mem2 == hint);
+
+    destroy_numa_range_allocator(nra);
+
+
+
+    // Range-level locking
+    striped_ralloc_t sra = create_striped_range_allocator(base, length, granularity, 4);
+
+    TEST("Concurrent ALLOCATE_EXACT on disjoint windows should all succeed");
+    std::vector<int> succeeded(length / granularity, 0);
+    threads.clear();
+    for (size_t t = 0; t < 4; t++) {
+        threads.push_back(std::thread([=, &succeeded]() {
+            for (size_t i = t; i < length / granularity; i += 4)
+                succeeded[i] = (striped_allocate_range(sra, granularity, ALLOCATE_EXACT, base + i * granularity) == base + i * granularity);
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    failed = false;
+    for (size_t i = 0; i < succeeded.size(); i++)
+        failed = failed || !succeeded[i];
+    CHECK(!failed);
+
+    TEST("Ranges freed on disjoint windows should be merged across stripes");
+    threads.clear();
+    for (size_t t = 0; t < 4; t++) {
+        threads.push_back(std::thread([=]() {
+            for (size_t i = t; i < length / granularity; i += 4)
+                striped_free_range(sra, base + i * granularity, granularity);
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    mem = striped_allocate_range(sra, length, ALLOCATE_ANY, 0);
+    CHECK(mem == base);
+
+    striped_free_range(sra, base, length);
+
+    TEST("ALLOCATE_ABOVE should find a range across the boundary between stripes");
+    striped_allocate_range(sra, length / 2, ALLOCATE_EXACT, base);
+    striped_allocate_range(sra, length / 8, ALLOCATE_EXACT, base + length - length / 8);
+    mem = striped_allocate_range(sra, length / 4 + granularity, ALLOCATE_ABOVE, hint);        // |________'---------------___|
+    CHECK(mem >= hint && mem + length / 4 + granularity <= base + length - length / 8);      //          ^^^^^^^^^^^^^^^     
+
+    TEST("ALLOCATE_NEAR should return the closest free address among all the stripes");
+    mem = striped_allocate_range(sra, granularity, ALLOCATE_NEAR, base + granularity);
+    CHECK(mem == hint);
+
+    destroy_striped_range_allocator(sra);
 }
\ No newline at end of file
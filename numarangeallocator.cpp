@@ -0,0 +1,214 @@
+#include "numarangeallocator.h"
+#include "partitionedallocator.h"
+
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+
+// Values of the memory policy used with the Linux mbind() system call (see <numaif.h>),
+// redefined here to avoid a dependency on libnuma.
+const int      numa_mpol_bind    = 2;
+const unsigned numa_mpol_mf_move = 1 << 1;
+
+// Returns the identifiers read from a sysfs file that contains a list of ranges, e.g. "0-1,3".
+// The list is empty if the file cannot be read.
+static std::vector<int> read_id_list(const char* path)
+{
+    std::vector<int> ids;
+#if defined(__linux__)
+    FILE* f = fopen(path, "r");
+    if (f)
+    {
+        int first = 0;
+        while (fscanf(f, "%d", &first) == 1)
+        {
+            int last = first;
+            int separator = fgetc(f);
+            if (separator == '-')
+            {
+                if (fscanf(f, "%d", &last) != 1) break;
+                separator = fgetc(f);
+            }
+            for (int id = first; id <= last; id++)
+            {
+                ids.push_back(id);
+            }
+            if (separator != ',') break;
+        }
+        fclose(f);
+    }
+#else
+    (void)path;
+#endif
+    return ids;
+}
+
+// Returns the identifiers of the online NUMA nodes, at least one.
+static std::vector<int> numa_nodes()
+{
+    std::vector<int> nodes = read_id_list("/sys/devices/system/node/online");
+    if (nodes.empty())
+    {
+        nodes.push_back(0);
+    }
+    return nodes;
+}
+
+#if defined(__linux__)
+// Returns the node of each CPU, indexed by CPU number; empty if the topology is unknown.
+static std::vector<int> numa_node_of_cpus()
+{
+    std::vector<int> node_of_cpu;
+    std::vector<int> nodes = numa_nodes();
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes[i]);
+        std::vector<int> cpus = read_id_list(path);
+        for (size_t c = 0; c < cpus.size(); c++)
+        {
+            if ((size_t)cpus[c] >= node_of_cpu.size())
+                node_of_cpu.resize(cpus[c] + 1, 0);
+            node_of_cpu[cpus[c]] = nodes[i];
+        }
+    }
+    return node_of_cpu;
+}
+#endif
+
+// Returns the NUMA node the calling thread runs on.
+// sched_getcpu() is served by the vDSO, without entering the kernel; the CPU is mapped to its node with a
+// table read once from sysfs.
+static int current_numa_node()
+{
+#if defined(__linux__)
+    static const std::vector<int> node_of_cpu = numa_node_of_cpus();
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && (size_t)cpu < node_of_cpu.size())
+        return node_of_cpu[cpu];
+#endif
+    return 0;
+}
+
+// Moves the pages entirely contained in [addr, addr + length) to the memory of the given node.
+// This is only a hint: nothing is done if the system does not support it.
+static void bind_to_numa_node(void* addr, size_t length, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    const uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (((uintptr_t)addr + page_size - 1) / page_size) * page_size;
+    uintptr_t end = (((uintptr_t)addr + length) / page_size) * page_size;
+    if (begin >= end) return;
+
+    const size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] |= 1UL << (node % bits);
+
+    // an error only means that the memory stays where it is
+    syscall(SYS_mbind, begin, end - begin, numa_mpol_bind, mask.data(), mask.size() * bits + 1, numa_mpol_mf_move);
+#else
+    (void)addr;
+    (void)length;
+    (void)node;
+#endif
+}
+
+
+class numa_range_allocator : public partitioned_range_allocator
+{
+public:
+    numa_range_allocator(vaddr_t base, size_t length, size_t granularity, const std::vector<int>& nodes, size_t node_count)
+        : partitioned_range_allocator(base, length, granularity, node_count)
+    {
+        // place the control structures of each partition on its node
+        for (size_t i = 0; i < partition_count(); i++)
+        {
+            _nodes.push_back(nodes[i % nodes.size()]);
+
+            span_manager_pool& pool = _partitions[i]->engine.span_manager();
+            for (size_t c = 0; c < pool.chunk_count(); c++)
+            {
+                bind_to_numa_node(pool.storage(c), pool.capacity(c) * sizeof(span), _nodes[i]);
+            }
+        }
+    }
+
+    vaddr_t allocate(size_t length, allocation_flags flags, vaddr_t hint)
+    {
+        if (flags == ALLOCATE_EXACT)
+            return allocate_exact(length, hint);
+
+        // try the node of the caller first, then the following ones
+        size_t local = local_index();
+        for (size_t i = 0; i < partition_count(); i++)
+        {
+            vaddr_t addr = allocate_in((local + i) % partition_count(), length, flags, hint);
+            if (addr != (vaddr_t)-1)
+                return addr;
+        }
+        return (vaddr_t)-1;
+    }
+
+private:
+
+    // index of the first partition located on the node of the calling thread
+    size_t local_index() const
+    {
+        int node = current_numa_node();
+        for (size_t i = 0; i < _nodes.size(); i++)
+        {
+            if (_nodes[i] == node)
+                return i;
+        }
+        return 0;
+    }
+
+private:
+    std::vector<int> _nodes;
+};
+
+
+
+numa_ralloc_t create_numa_range_allocator(vaddr_t base, size_t length, size_t granularity, size_t node_count)
+{
+    if (!base) return 0;
+    if (!length) return 0;
+    if (!granularity) return 0;
+    if (granularity > length) return 0;
+
+    std::vector<int> nodes = numa_nodes();
+    return new numa_range_allocator(base, length, granularity, nodes, node_count ? node_count : nodes.size());
+}
+
+void destroy_numa_range_allocator(numa_ralloc_t ralloc)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+
+    delete static_cast<numa_range_allocator*>(ralloc);
+}
+
+vaddr_t numa_allocate_range(numa_ralloc_t ralloc, size_t length, allocation_flags flags, vaddr_t optional_hint)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return (vaddr_t)-1;
+
+    return static_cast<numa_range_allocator*>(ralloc)->allocate(length, flags, optional_hint);
+}
+
+void numa_free_range(numa_ralloc_t ralloc, vaddr_t base, size_t length)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+
+    static_cast<numa_range_allocator*>(ralloc)->free(base, length);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "rangeallocator.h"
+
+
+// NUMA-aware front end of the range allocator.
+// The range is split into one sub-range per NUMA node, each one managed by its own range allocator whose control
+// structures are placed in the memory of that node. Allocations are served first by the sub-allocator of the node
+// the calling thread runs on, then by the other ones. Each sub-allocator has its own lock, so the functions are
+// thread-safe and threads running on different nodes do not contend.
+// On systems without NUMA support (or with a single node), it behaves as a locked range allocator.
+typedef void *numa_ralloc_t;
+
+// Creates a NUMA-aware range allocator representing the range [base, base + length).
+// The parameter node_count gives the number of sub-ranges, 0 to use the number of NUMA nodes of the system.
+// Other parameters are the same as create_range_allocator().
+numa_ralloc_t create_numa_range_allocator(vaddr_t base, size_t length, size_t granularity, size_t node_count);
+
+// Frees all control structures associated with the specified range allocator.
+// No other thread must use the allocator at this time.
+void destroy_numa_range_allocator(numa_ralloc_t ralloc);
+
+// Same as allocate_range(), preferring the sub-range of the node of the calling thread.
+// A single allocation cannot be larger than a sub-range, except with ALLOCATE_EXACT.
+vaddr_t numa_allocate_range(numa_ralloc_t ralloc, size_t length, allocation_flags flags, vaddr_t optional_hint);
+
+// Same as free_range(). The released range may span several sub-ranges.
+void numa_free_range(numa_ralloc_t ralloc, vaddr_t base, size_t length);
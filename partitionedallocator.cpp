@@ -0,0 +1,103 @@
+#include "partitionedallocator.h"
+
+
+partitioned_range_allocator::partitioned_range_allocator(vaddr_t base, size_t length, size_t granularity, size_t partition_count)
+    : _base(base), _granularity(granularity)
+{
+    // each partition must contain at least one block
+    size_t blocks = length / granularity;
+    if (partition_count > blocks) partition_count = blocks;
+    if (partition_count == 0) partition_count = 1;
+
+    _partition_length = (blocks / partition_count) * granularity;
+    _length = blocks * granularity;
+
+    for (size_t i = 0; i < partition_count; i++)
+    {
+        vaddr_t partition_base = base + i * _partition_length;
+        size_t  partition_length = (i == partition_count - 1) ? _length - i * _partition_length : _partition_length;
+        _partitions.push_back(new partition(partition_base, partition_length, granularity));
+    }
+}
+
+partitioned_range_allocator::~partitioned_range_allocator()
+{
+    for (size_t i = 0; i < _partitions.size(); i++)
+    {
+        delete _partitions[i];
+    }
+}
+
+vaddr_t partitioned_range_allocator::allocate_in(size_t index, size_t length, allocation_flags flags, vaddr_t hint)
+{
+    partition* p = _partitions[index];
+    std::lock_guard<std::mutex> lock(p->mutex);
+    return p->engine.allocate(length, flags, hint);
+}
+
+vaddr_t partitioned_range_allocator::allocate_exact(size_t length, vaddr_t hint)
+{
+    length = align_length(length);
+
+    if (length == 0) return (vaddr_t)-1;
+    if (hint < _base || hint + length > _base + _length) return (vaddr_t)-1;
+
+    size_t first = index_of(hint);
+    size_t last = index_of(hint + length - 1);
+
+    // lock the partitions in ascending order
+    std::vector<std::unique_lock<std::mutex> > locks;
+    for (size_t i = first; i <= last; i++)
+    {
+        locks.push_back(std::unique_lock<std::mutex>(_partitions[i]->mutex));
+    }
+
+    return allocate_exact_locked(hint, length) ? hint : (vaddr_t)-1;
+}
+
+bool partitioned_range_allocator::allocate_exact_locked(vaddr_t base, size_t length)
+{
+    size_t first = index_of(base);
+    size_t last = index_of(base + length - 1);
+
+    for (size_t i = first; i <= last; i++)
+    {
+        partition* p = _partitions[i];
+        vaddr_t begin = base > p->base ? base : p->base;
+        vaddr_t end = base + length < p->base + p->length ? base + length : p->base + p->length;
+
+        if (p->engine.allocate(end - begin, ALLOCATE_EXACT, begin) == (vaddr_t)-1)
+        {
+            // roll back the parts already allocated, they all end at the end of their partition
+            for (size_t j = first; j < i; j++)
+            {
+                partition* q = _partitions[j];
+                vaddr_t q_begin = base > q->base ? base : q->base;
+                q->engine.free(q_begin, q->base + q->length - q_begin);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void partitioned_range_allocator::free(vaddr_t base, size_t length)
+{
+    // Align base and length on granularity, as the allocators of the partitions do.
+    base   = (base / _granularity) * _granularity;
+    length = align_length(length);
+
+    if (length == 0) return;
+    if (base < _base || base + length > _base + _length) return; // the range to free must be contained entirely
+
+    // release the part of the range that belongs to each partition
+    for (size_t i = index_of(base); i <= index_of(base + length - 1); i++)
+    {
+        partition* p = _partitions[i];
+        vaddr_t begin = base > p->base ? base : p->base;
+        vaddr_t end = base + length < p->base + p->length ? base + length : p->base + p->length;
+
+        std::lock_guard<std::mutex> lock(p->mutex);
+        p->engine.free(begin, end - begin);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "rangeallocatorimpl.h"
+
+#include <mutex>
+#include <vector>
+
+
+// A range split into contiguous sub-ranges (partitions) of equal size, each one managed by its own range allocator
+// and protected by its own lock. The locks form a table indexed by address: operations on disjoint partitions
+// can proceed in parallel. Ranges crossing the boundary between partitions are handled by locking all the
+// partitions they cover, in ascending order.
+// This is the base of the thread-safe front ends that need to partition the range.
+class partitioned_range_allocator
+{
+public:
+    // The last partition receives the remaining blocks if the range cannot be split evenly.
+    partitioned_range_allocator(vaddr_t base, size_t length, size_t granularity, size_t partition_count);
+    ~partitioned_range_allocator();
+
+    // Allocates from a single partition.
+    vaddr_t allocate_in(size_t index, size_t length, allocation_flags flags, vaddr_t hint);
+
+    // Allocates exactly [hint, hint + length), possibly across several partitions: all the parts are
+    // allocated, or none of them.
+    vaddr_t allocate_exact(size_t length, vaddr_t hint);
+
+    // Releases a range, possibly across several partitions.
+    void free(vaddr_t base, size_t length);
+
+protected:
+    // A sub-range, its allocator and its lock.
+    struct partition
+    {
+        partition(vaddr_t base, size_t length, size_t granularity)
+            : engine(base, length, granularity), base(base), length(length)
+        {}
+
+        range_allocator<span_manager_pool> engine;
+        std::mutex                         mutex;
+        vaddr_t                            base;
+        size_t                             length;
+    };
+
+    size_t partition_count() const
+    {
+        return _partitions.size();
+    }
+
+    // index of the partition containing the address
+    size_t index_of(vaddr_t addr) const
+    {
+        size_t i = (addr - _base) / _partition_length;
+        return i < _partitions.size() ? i : _partitions.size() - 1;
+    }
+
+    size_t align_length(size_t length) const
+    {
+        return ((length + _granularity - 1) / _granularity) * _granularity;
+    }
+
+    // Allocates exactly [base, base + length) in all the partitions it covers, the caller holds their locks.
+    bool allocate_exact_locked(vaddr_t base, size_t length);
+
+protected:
+    vaddr_t                 _base;
+    size_t                  _length;
+    size_t                  _granularity;
+    size_t                  _partition_length;
+    std::vector<partition*> _partitions;
+};
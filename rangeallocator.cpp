@@ -1,465 +1,261 @@
 #include "rangeallocator.h"
+#include "rangeallocatorimpl.h"
+#include "rangeallocatortrace.h"
 
-#include <vector>
 
+// Change the type here to change the strategy for span allocation
+typedef span_manager_pool AllocatorStrategy;
+//typedef span_manager_allocate AllocatorStrategy;
+//typedef span_manager_epoch<span_manager_pool> AllocatorStrategy;
 
-// Represents a contiguous run of memory and can be used in a linked-list.
-struct span
+
+ralloc_t create_range_allocator(vaddr_t base, size_t length, size_t granularity)
 {
-    span*   next;
-    vaddr_t base;
-    size_t  length;
-};
+    if (!base) return 0;
+    if (!length) return 0;
+    if (!granularity) return 0;
+    if (granularity > length) return 0;
 
+    ralloc_t ralloc = new range_allocator<AllocatorStrategy>(base, length, granularity);
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_CREATE, ralloc, 0, base, length, granularity, 1);
+    return ralloc;
+}
 
-// manager of span instances that uses a pool that is fully allocated at start
-class span_manager_pool
+void destroy_range_allocator(ralloc_t ralloc)
 {
-public:
-    span_manager_pool(size_t max_instances)
-        : _pool(max_instances)
-    {
-        for (size_t i = 0; i < max_instances - 1; i++)
-        {
-            _pool[i].next = &_pool[i + 1];
-        }
-        _pool[max_instances - 1].next = 0;
-        _available_spans = &_pool[0];
-    }
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
 
-    ~span_manager_pool()
-    {}
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_DESTROY, ralloc, 0, 0, 0, 0, 0);
 
-    span* get()
-    {
-        span* s = _available_spans;
-        if (s)
-        {
-            _available_spans = s->next;
-            return s;
-        }
-        return 0;
-    }
+    range_allocator<AllocatorStrategy>* allocator = static_cast<range_allocator<AllocatorStrategy>*>(ralloc);
+    delete allocator;
+}
 
-    void release(span* s)
-    {
-        s->next = _available_spans;
-        _available_spans = s;
-    }
+int range_allocator_add_region(ralloc_t ralloc, vaddr_t base, size_t length)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return 0;
 
-private:
-    std::vector<span> _pool;
-    span * _available_spans;
-};
+    int result = static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->add_region(base, length) ? 1 : 0;
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_ADD_REGION, ralloc, 0, base, length, 0, result);
+    return result;
+}
 
-// manager of span instances that keeps a list of allocated objects and create a new one only if the list is empty
-class span_manager_allocate
+int extend_range_allocator(ralloc_t ralloc, size_t additional_length)
 {
-public:
-    span_manager_allocate(size_t /*max_instances*/)
-    {
-        _available_spans = 0;
-    }
-
-    ~span_manager_allocate()
-    {
-        span* current = _available_spans;
-        while (current)
-        {
-            span* next = current->next;
-            delete current;
-            current = next;
-        }
-    }
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return 0;
 
-    span* get()
-    {
-        span* s = _available_spans;
-        if (s)
-        {
-            _available_spans = s->next;
-            return s;
-        }
-        return new span;
-    }
+    int result = static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->extend(additional_length) ? 1 : 0;
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_EXTEND, ralloc, 0, additional_length, 0, 0, result);
+    return result;
+}
 
-    void release(span* s)
-    {
-        s->next = _available_spans;
-        _available_spans = s;
-    }
+void reset_range_allocator(ralloc_t ralloc)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
 
-private:
-    span* _available_spans;
-};
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->reset();
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_RESET, ralloc, 0, 0, 0, 0, 0);
+}
 
+vaddr_t allocate_range(ralloc_t ralloc, size_t length, allocation_flags flags, vaddr_t optional_hint)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return (vaddr_t)-1;
 
+    vaddr_t result = static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->allocate(length, flags, optional_hint);
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_ALLOCATE, ralloc, flags, length, 0, optional_hint, result);
+    return result;
+}
 
-template <class SpanAllocator>
-class range_allocator
+vaddr_t allocate_range_aligned(ralloc_t ralloc, size_t length, size_t alignment, allocation_flags flags, vaddr_t optional_hint)
 {
-public:
-    // Construct a new instance.
-    // The stored length value is the size of the memory range that is effectively accessible given
-    // the provided granularity. It can be smaller than or equal to the provided length value.
-    range_allocator(vaddr_t base, size_t length, size_t granularity)
-        : _base(base), _length(length), _granularity(granularity), _spans((length / granularity) / 2)
-    {
-        // adjust the base address on next granularity bound
-        // correct length in consequence
-        //_base = ((base + _granularity - 1) / _granularity) * _granularity;
-        //_length = length - (_base - base);
-
-        // align the corrected length on previous granularity bound
-        _length = (_length / _granularity) * _granularity;
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return (vaddr_t)-1;
 
-        span* s = add_span();
-        s->base = _base;
-        s->length = _length;
-        s->next = 0;
+    vaddr_t result = static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->allocate(length, flags, optional_hint, alignment);
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_ALLOCATE, ralloc, flags, length, alignment, optional_hint, result);
+    return result;
+}
 
-        _free_mem_root.next = s;
-    }
+vaddr_t allocate_range_between(ralloc_t ralloc, size_t length, vaddr_t lo, vaddr_t hi)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return (vaddr_t)-1;
 
-    ~range_allocator()
-    {
-        // Release all used spans and let the span allocator manage its destruction
-        while (_free_mem_root.next)
-        {
-            span* s = _free_mem_root.next;
-            _free_mem_root.next = _free_mem_root.next->next;
-            _spans.release(s);
-        }
-    }
+    vaddr_t result = static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->allocate_between(length, lo, hi);
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_ALLOCATE_BETWEEN, ralloc, 0, length, lo, hi, result);
+    return result;
+}
 
-    vaddr_t allocate(size_t length, allocation_flags flags, vaddr_t hint)
-    {
-        // Align the length to the upper granularity boundary
-        length = ((length + _granularity - 1) / _granularity) * _granularity;
+vaddr_t resize_range(ralloc_t ralloc, vaddr_t base, size_t old_length, size_t new_length)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return (vaddr_t)-1;
 
-        if (length == 0) return (vaddr_t)-1;
-        if (length > _length) return (vaddr_t)-1;
+    vaddr_t result = static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->resize(base, old_length, new_length);
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_RESIZE, ralloc, 0, base, old_length, new_length, result);
+    return result;
+}
 
-        // find the first span that match the request
-        span* previous = &_free_mem_root;
-        span* current = _free_mem_root.next;
-        while (current)
-        {
-            if (check_span(current, length, flags, hint))
-                break;
+void set_range_allocator_placement(ralloc_t ralloc, placement_policy placement)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
 
-            previous = current;
-            current = current->next;
-        }
-        
-        // no available block
-        if (!current) return (vaddr_t)-1;
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->set_placement(placement);
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_PLACEMENT, ralloc, placement, 0, 0, 0, 0);
+}
 
-        // truncate the found span and get the base allocation
-        return split_span(previous, current, length, flags, hint);
-    }
+size_t allocate_ranges(ralloc_t ralloc, size_t length, size_t count, allocation_flags flags, vaddr_t optional_hint, vaddr_t* bases)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return 0;
+    if (!bases) return 0;
 
-    void free(vaddr_t base, size_t length)
+    size_t allocated = static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->allocate_many(length, count, flags, optional_hint, bases);
+    if (is_range_allocator_tracing())
     {
-        // Align base and length on granularity.
-        // Maybe an error if base is not aligned as this should be a value returned by the allocator.
-        base   = (base / _granularity) * _granularity;
-        length = ((length + _granularity - 1) / _granularity) * _granularity;
-
-        if (length == 0) return;
-        if (base < _base || base >= _base+_length) return; // base MUST be in the range
-        if (base + length > _base + _length) return; // the range to free must be contained entirely 
-        
-        //
-        span* curr = &_free_mem_root;
-        span* next = _free_mem_root.next;
-        while (next)
+        for (size_t i = 0; i < count; i++)
         {
-            //    curr                        next              
-            // |--------|..................|--------|...........
-            //                   |-------|                      
-            if (base + length < next->base)
-            {
-                // include a new span in the list
-                span* s = add_span();
-                s->base = base;
-                s->length = length;
-                s->next = next;
-                curr->next = s;
-                return;
-            }
-
-            //    curr                        next              
-            // |--------|..................|--------|...........
-            //                     |-------|                    
-            if (base + length == next->base)
-            {
-                // merge the free region at the beginning of the next span
-                next->base = base;
-                next->length += length;
-                return;
-            }
-
-            //    curr                        next              
-            // |--------|..................|--------|...........
-            //                         |-------|                
-            //                           |--------------|       
-            //                                   |-------|       
-            if (base < next->base + next->length)
-            {
-                // intersection is not empty: treat this as an error
-                return;
-            }
-
-
-            //    curr                        next              
-            // |--------|..................|--------|...........
-            //                                      |-------|   
-            if (base == next->base + next->length)
-            {
-                // check any overlap with next next
-                if (next->next)
-                {
-                    //    next           next->next        
-                    // |--------|........|--------|
-                    //          |------------|   
-                    if (base + length > next->next->base)
-                    {
-                        // intersection is not empty: treat this as an error
-                        return;
-                    }
-
-                    //    next           next->next        
-                    // |--------|........|--------|
-                    //          |--------|   
-                    if (base + length == next->next->base)
-                    {
-                        // merge with next span
-                        next->length += length + next->next->length;
-                        remove_span(next, next->next);
-                        return;
-                    }
-                }
-
-                // merge the free region at the end of the next span
-                next->length += length;
-                return;
-            }
-
-            //    curr                        next              
-            // |--------|..................|--------|...........
-            //                                        |-------| 
-            //if (base > next->base + next->length)
-
-            curr = next;
-            next = next->next;
+            if (bases[i] != (vaddr_t)-1)
+                record_range_allocator_call(TRACE_ALLOCATE, ralloc, ALLOCATE_EXACT, length, 0, bases[i], bases[i]);
         }
-
-        // no more span, include a new one at the end of the list
-        span* s = add_span();
-        s->base = base;
-        s->length = length;
-        s->next = 0;
-        curr->next = s;
     }
+    return allocated;
+}
 
-private:
-
-    span* add_span()
-    {
-        return _spans.get();
-    }
+void free_range(ralloc_t ralloc, vaddr_t base, size_t length)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
 
-    void remove_span(span* prev, span* curr)
-    {
-        prev->next = curr->next;
-        _spans.release(curr);
-    }
+    if (is_range_allocator_tracing()) record_range_allocator_call(TRACE_FREE, ralloc, 0, base, length, 0, 0);
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->free(base, length);
+}
 
-    // check if the span satisfy the constraints
-    bool check_span(span* s, size_t length, allocation_flags flags, vaddr_t hint)
-    {
-        switch (flags)
-        {
-        case ALLOCATE_ANY:
-            // need any span that has more than <length> bytes
-            return (s->length >= length);
-
-        case ALLOCATE_EXACT:
-            // need a span that contains entirely [hint, hint+length[
-            return (s->base <= hint) && (hint + length <= s->base + s->length);
-
-        case ALLOCATE_ABOVE:
-            if (s->base >= hint)
-            {
-                // _____'_____-----------_________
-                //                   ^^^^         
-                return (s->length >= length);
-            }
-            else if (s->base + s->length >= hint)
-            {
-                // ___________----'------_________
-                //                   ^^^^         
-                return (s->base + s->length >= hint + length);
-            }
-            return false;
-
-        case ALLOCATE_BELOW:
-            // s    |----------------h------------|
-            //      |----------|                   
-            return (s->base + length <= hint) && (s->length >= length);
-        }
-        return false;
-    }
+void free_ranges(ralloc_t ralloc, const range* ranges, size_t count)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+    if (!ranges) return;
 
-    // truncate the current span of <length> bytes on the lower addresses
-    void trunc_span_low(span* prev, span* curr, size_t length)
+    if (is_range_allocator_tracing())
     {
-        if (length == curr->length)
+        for (size_t i = 0; i < count; i++)
         {
-            remove_span(prev, curr);
-        }
-        else
-        {
-            curr->base += length;
-            curr->length -= length;
+            record_range_allocator_call(TRACE_FREE, ralloc, 0, ranges[i].base, ranges[i].length, 0, 0);
         }
     }
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->free_many(ranges, count);
+}
 
-    // truncate the current span of <length> bytes on the higher addresses
-    void trunc_span_high(span* prev, span* curr, size_t length)
-    {
-        if (length == curr->length)
-        {
-            remove_span(prev, curr);
-        }
-        else
-        {
-            curr->length -= length;
-        }
-    }
+void set_range_allocator_deferred_free(ralloc_t ralloc, int enable)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
 
-    // truncate the current span of <length> bytes starting at <base>
-    void trunc_span_middle(span* prev, span* curr, vaddr_t base, size_t length)
-    {
-        if (length == curr->length)
-        {
-            remove_span(prev, curr);
-        }
-        else
-        {
-            span* s = add_span();
-            s->base = base + length;
-            s->length = curr->base + curr->length - s->base;
-            s->next = curr->next;
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->set_deferred_free(enable != 0);
+}
 
-            curr->length = base - curr->base;
-            curr->next = s;
-        }
-    }
+void flush_range_allocator(ralloc_t ralloc)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
 
-    // remove a sub-span from the current span
-    vaddr_t split_span(span* prev, span* curr, size_t length, allocation_flags flags, vaddr_t hint)
-    {
-        vaddr_t base = (vaddr_t )-1;
-        switch (flags)
-        {
-        case ALLOCATE_ANY:
-            // curr  |---------------------| 
-            // alloc |------------|
-            base = curr->base;
-            trunc_span_low(prev, curr, length);
-            break;
-
-        case ALLOCATE_EXACT:
-            base = hint;
-            if (curr->base == hint)
-            {
-                // curr  h---------------------| 
-                // alloc |------------|
-                trunc_span_low(prev, curr, length);
-            }
-            else if (hint + length == curr->base + curr->length)
-            {
-                // curr  |--------h------------| 
-                // alloc          |------------|
-                trunc_span_high(prev, curr, length);
-            }
-            else
-            {
-                // curr  |-----h---------------| 
-                // alloc       |------------|
-                trunc_span_middle(prev, curr, hint, length);
-            }
-            break;
-
-        case ALLOCATE_ABOVE:
-            // curr      |----h-----------------| 
-            // alloc               |------------|
-            base = curr->base + curr->length - length;
-            trunc_span_high(prev, curr, length);
-            break;
-
-        case ALLOCATE_BELOW:
-            // s    |----------------h------------|
-            //      |----------|                   
-            base = curr->base;
-            trunc_span_low(prev, curr, length);
-            break;
-        }
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->flush();
+}
 
-        return base;
-    }
+void get_range_allocator_stats(ralloc_t ralloc, range_allocator_stats* stats)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+    if (!stats) return;
 
-private:
-    vaddr_t       _base;
-    size_t        _length;
-    size_t        _granularity;
-    span          _free_mem_root;
-    SpanAllocator _spans;
-};
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->stats(*stats);
+}
 
+void get_range_allocator_fragmentation(ralloc_t ralloc, range_allocator_fragmentation* fragmentation)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+    if (!fragmentation) return;
 
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->fragmentation(*fragmentation);
+}
 
-// Change the type here to change the strategy for span allocation
-typedef span_manager_pool AllocatorStrategy;
-//typedef span_manager_allocate AllocatorStrategy;
+void set_range_allocator_latency_tracking(ralloc_t ralloc, int enable)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
 
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->set_latency_tracking(enable != 0);
+}
 
-ralloc_t create_range_allocator(vaddr_t base, size_t length, size_t granularity)
+int get_range_allocator_latency(ralloc_t ralloc, int operation, range_allocator_latency* latency)
 {
-    if (!base) return 0;
-    if (!length) return 0;
-    if (!granularity) return 0;
-    if (granularity > length) return 0;
-
-    return new range_allocator<AllocatorStrategy>(base, length, granularity);
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return 0;
+    if (!latency) return 0;
+    if (operation < 0) return 0;
+
+    const latency_histogram* histogram = static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->latency((size_t)operation);
+    if (!histogram) return 0;
+
+    latency->count = histogram->count();
+    latency->p50 = histogram->percentile(0.5);
+    latency->p99 = histogram->percentile(0.99);
+    latency->p999 = histogram->percentile(0.999);
+    latency->max = histogram->max();
+    return 1;
 }
 
-void destroy_range_allocator(ralloc_t ralloc)
+void reset_range_allocator_latency(ralloc_t ralloc)
 {
     // check here for sanity, but we have no way to check that the pointer is valid 
     // without adding some kind of header/signature
     if (!ralloc) return;
 
-    range_allocator<AllocatorStrategy>* allocator = static_cast<range_allocator<AllocatorStrategy>*>(ralloc);
-    delete allocator;
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->reset_latency();
 }
 
-vaddr_t allocate_range(ralloc_t ralloc, size_t length, allocation_flags flags, vaddr_t optional_hint)
+void export_range_allocator_spans(ralloc_t ralloc, range_allocator_span_visitor visitor, void* context)
 {
     // check here for sanity, but we have no way to check that the pointer is valid 
     // without adding some kind of header/signature
-    if (!ralloc) return (vaddr_t)-1;
+    if (!ralloc) return;
+    if (!visitor) return;
 
-    return static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->allocate(length, flags, optional_hint);
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->visit_spans(visitor, context);
 }
 
-void free_range(ralloc_t ralloc, vaddr_t base, size_t length)
+void export_range_allocator_free_map(ralloc_t ralloc, uint8_t* map, size_t count)
 {
     // check here for sanity, but we have no way to check that the pointer is valid 
     // without adding some kind of header/signature
     if (!ralloc) return;
+    if (!map) return;
 
-    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->free(base, length);
+    static_cast<range_allocator<AllocatorStrategy>*>(ralloc)->free_map(map, count);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h> // for size_t
 #include <stdint.h> // for uintptr_t
 
 
@@ -10,11 +11,77 @@ typedef enum
     ALLOCATE_ANY,
     ALLOCATE_EXACT,
     ALLOCATE_ABOVE,
-    ALLOCATE_BELOW
+    ALLOCATE_BELOW,
+    ALLOCATE_NEAR
 } allocation_flags;
 
+typedef enum
+{
+    PLACEMENT_DEFAULT,
+    PLACEMENT_HINT_LOCAL
+} placement_policy;
+
 typedef uintptr_t vaddr_t;
 
+typedef struct
+{
+    vaddr_t base;
+    size_t  length;
+} range;
+
+// Number of allocation flags, and of buckets of the histogram of the spans visited per operation.
+#define RANGE_ALLOCATOR_FLAG_COUNT    5
+#define RANGE_ALLOCATOR_VISIT_BUCKETS 24
+
+typedef struct
+{
+    // Operation counters, indexed by allocation flags. They are always 0 when the allocator is built with
+    // RANGE_ALLOCATOR_NO_STATS defined.
+    // The allocations are counted for:
+    //  - allocate_range() and allocate_range_aligned(), under their flags,
+    //  - allocate_ranges(), once per range requested, under its flags,
+    //  - allocate_range_between(), under ALLOCATE_ANY,
+    //  - resize_range() when the range grows, under ALLOCATE_EXACT (a shrink counts as a release).
+    uint64_t allocations[RANGE_ALLOCATOR_FLAG_COUNT];           // successful allocations
+    uint64_t allocation_failures[RANGE_ALLOCATOR_FLAG_COUNT];   // allocations that returned (vaddr_t)-1
+    uint64_t frees;                                             // ranges merged by free_range()/free_ranges()/flush_range_allocator()
+    // Histogram of the number of spans visited per allocation or release (a batch of ranges counts as one operation):
+    // bucket 0 counts the operations that visited no span, bucket i those that visited [2^(i-1), 2^i) spans,
+    // and the last one all the longer walks.
+    uint64_t visited_spans[RANGE_ALLOCATOR_VISIT_BUCKETS];
+
+    // State of the free space, the ranges queued in deferred free mode are not counted until they are merged.
+    size_t   span_count;
+    size_t   free_bytes;
+    size_t   largest_free_span;
+    size_t   span_pool_high_water;                              // maximum number of spans in use at once, 0 with RANGE_ALLOCATOR_NO_STATS
+} range_allocator_stats;
+
+// Number of buckets of the histogram of free blocks by size.
+#define RANGE_ALLOCATOR_SIZE_BUCKETS (sizeof(size_t) * 8)
+
+typedef struct
+{
+    size_t free_bytes;
+    size_t largest_free_span;
+    size_t span_count;
+    size_t spans_by_size[RANGE_ALLOCATOR_SIZE_BUCKETS];     // bucket i counts the free blocks of [2^i, 2^(i+1)) bytes
+    double ratio;                                           // external fragmentation: 1 - largest_free_span / free_bytes, 0 if no free space
+} range_allocator_fragmentation;
+
+// Index of the releases in the latency histograms, the allocations are indexed by their allocation flags.
+#define RANGE_ALLOCATOR_LATENCY_FREE RANGE_ALLOCATOR_FLAG_COUNT
+
+// Latencies of an operation, in nanoseconds. The percentiles are rounded up, with a relative error below 25%.
+typedef struct
+{
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} range_allocator_latency;
+
 // Creates, and returns an opaque handle, to a range allocator representing the range[base, base + length).
 // The parameter granularity specifies the required granularity for the allocations : 
 // all allocations shall be rounded to a size multiple of the granularity.
@@ -23,6 +90,21 @@ ralloc_t create_range_allocator(vaddr_t base, size_t length, size_t granularity)
 // Frees all control structures associated with the specified range allocator.
 void destroy_range_allocator(ralloc_t ralloc);
 
+// Adds the free range [base, base + length) to the ranges managed by the allocator, for instance a memory
+// region that is not contiguous with the first one. The region must not overlap the managed regions, and
+// base must be on the granularity grid of the allocator; length is rounded down to the granularity.
+// Allocations never cross the boundary between two regions, even if they are adjacent.
+// Returns a nonzero value on success, 0 if the region is rejected.
+int range_allocator_add_region(ralloc_t ralloc, vaddr_t base, size_t length);
+
+// Grows the range [base, base + length) given at creation by additional_length bytes at its end, without
+// rebuilding the allocator. The new memory is free; additional_length is rounded down to the granularity.
+// Returns a nonzero value on success, 0 if the extension is empty or overlaps a region added to the allocator.
+int extend_range_allocator(ralloc_t ralloc, size_t additional_length);
+
+// Frees all the ranges of the specified range allocator at once, without destroying it.
+void reset_range_allocator(ralloc_t ralloc);
+
 // Allocates a range of the specified length and return the base address.
 // The allocation flags parameter are interpreted as follows :
 //  - ALLOCATE_ANY   : Allocates in any available address big enough to contain the requested length. The parameter optional_hint is ignored.
@@ -30,8 +112,90 @@ void destroy_range_allocator(ralloc_t ralloc);
 //  - ALLOCATE_ABOVE : Allocates the requested length above the address specified by optional_hint.
 //  - ALLOCATE_BELOW : Allocates the requested length below the address specified by optional_hint.
 //                     The complete allocated range must reside below the hint, not just the starting address.
+//  - ALLOCATE_NEAR  : Allocates the requested length at the free address closest to optional_hint, on either side.
 // If the allocation cannot be satisfied, allocate_range() shall return (vaddr_t)-1.
 vaddr_t allocate_range(ralloc_t ralloc, size_t length,allocation_flags flags, vaddr_t optional_hint);
 
+// Same as allocate_range(), but the returned address is also a multiple of alignment.
+// The alignment must be a multiple of the granularity. The unused parts of the free block before and after
+// the aligned range stay available.
+vaddr_t allocate_range_aligned(ralloc_t ralloc, size_t length, size_t alignment, allocation_flags flags, vaddr_t optional_hint);
+
+// Allocates a range of the specified length that resides entirely in the window [lo, hi) and returns its base address.
+// The range is placed at the lowest available address of the window.
+// If the allocation cannot be satisfied, (vaddr_t)-1 is returned.
+vaddr_t allocate_range_between(ralloc_t ralloc, size_t length, vaddr_t lo, vaddr_t hi);
+
+// Grows or shrinks in place the range [base, base + old_length) previously allocated, without moving it.
+// A range can only grow if the memory that directly follows it is free and in the same region (see
+// range_allocator_add_region()); when it shrinks, its tail is released.
+// Returns base, or (vaddr_t)-1 if the range cannot be resized in place (the range is then left unchanged).
+vaddr_t resize_range(ralloc_t ralloc, vaddr_t base, size_t old_length, size_t new_length);
+
+// Sets the placement of the ranges allocated with ALLOCATE_ABOVE and ALLOCATE_BELOW:
+//  - PLACEMENT_DEFAULT    : ALLOCATE_ABOVE takes the upper end of the first block above the hint,
+//                           ALLOCATE_BELOW takes the lower end of the lowest block.
+//  - PLACEMENT_HINT_LOCAL : ALLOCATE_ABOVE returns the lowest address above the hint,
+//                           ALLOCATE_BELOW returns the highest range ending below the hint.
+//                           Allocations stay clustered around the hint.
+void set_range_allocator_placement(ralloc_t ralloc, placement_policy placement);
+
+// Allocates up to count ranges of the specified length in a single call and stores their base addresses in bases.
+// The flags are interpreted as for allocate_range(), the ranges are carved consecutively from each available block.
+// With ALLOCATE_EXACT, the ranges are consecutive and the first one starts at optional_hint.
+// With ALLOCATE_NEAR, and with ALLOCATE_BELOW in PLACEMENT_HINT_LOCAL placement, each range is placed in turn as close
+// to optional_hint as possible, as by successive calls to allocate_range(): this takes one walk of the free blocks per
+// range instead of a single one.
+// Returns the number of ranges allocated; the remaining entries of bases are set to (vaddr_t)-1.
+size_t allocate_ranges(ralloc_t ralloc, size_t length, size_t count, allocation_flags flags, vaddr_t optional_hint, vaddr_t* bases);
+
 // Releases a range (or part of a range) previously allocated.
 void free_range(ralloc_t ralloc, vaddr_t base, size_t length);
+
+// Releases several ranges at once. The ranges are sorted by base address and merged in a single pass.
+// Each range is checked as in free_range(): a range that overlaps a free block is ignored.
+void free_ranges(ralloc_t ralloc, const range* ranges, size_t count);
+
+// Enables (enable != 0) or disables the deferred free mode.
+// In this mode, free_range() only queues the range in a bounded lock-free queue and returns immediately. It can then be
+// called from any thread, concurrently with the thread that enabled the mode, which is the one that allocates.
+// The queued ranges are sorted and merged in a single pass by the next call to allocate_range() or flush_range_allocator().
+// While the mode is enabled, the allocating thread holds a lock on the free blocks during each call. When the queue is
+// full, free_range() takes this lock and merges the queue itself: it only waits while another call is in progress.
+// Disabling the mode merges all the queued ranges.
+void set_range_allocator_deferred_free(ralloc_t ralloc, int enable);
+
+// Merges the ranges queued by free_range() in deferred free mode.
+void flush_range_allocator(ralloc_t ralloc);
+
+// Fills stats with the counters and the state of the free space of the allocator.
+void get_range_allocator_stats(ralloc_t ralloc, range_allocator_stats* stats);
+
+// Fills fragmentation with the metrics of the free space. They are maintained by each allocation and release,
+// so that the call takes constant time and never walks the free blocks.
+void get_range_allocator_fragmentation(ralloc_t ralloc, range_allocator_fragmentation* fragmentation);
+
+// Enables (enable != 0) or disables the timing of each call to allocate_range()/allocate_range_aligned() and
+// free_range(), except the releases queued in deferred free mode. The latencies are recorded in per-allocator
+// histograms, without lock; disabling the timing discards them.
+void set_range_allocator_latency_tracking(ralloc_t ralloc, int enable);
+
+// Fills latency with the latencies of an operation: an allocation flag, or RANGE_ALLOCATOR_LATENCY_FREE.
+// Returns 0 if the timing is disabled or the operation is unknown.
+int get_range_allocator_latency(ralloc_t ralloc, int operation, range_allocator_latency* latency);
+
+// Clears the latency histograms.
+void reset_range_allocator_latency(ralloc_t ralloc);
+
+// Function called for each free block by export_range_allocator_spans().
+typedef void (*range_allocator_span_visitor)(void* context, vaddr_t base, size_t length);
+
+// Calls visitor for each free block, in increasing address order, in a single walk and without allocation.
+// The allocator must not be modified by the visitor.
+void export_range_allocator_spans(ralloc_t ralloc, range_allocator_span_visitor visitor, void* context);
+
+// Fills map with a downsampled occupancy map of the allocator: the address space, from the lowest to the highest
+// address of its regions, is split into count windows of equal size, and map[i] is the ratio of free memory in the
+// i-th window, from 0 (allocated) to 255 (free). Done in a single walk, without allocation.
+// See heatmap/freemap.h to turn successive maps into an image.
+void export_range_allocator_free_map(ralloc_t ralloc, uint8_t* map, size_t count);
@@ -0,0 +1,1565 @@
+#pragma once
+
+#include "rangeallocator.h"
+#include "spanmanager.h"
+#include "latencyhistogram.h"
+#include "rangeallocatorprobes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+// Ranges released in deferred free mode, waiting to be merged into the list of spans: a bounded ring written by
+// any thread and read by the thread that allocates. Each slot carries a sequence number that tells whether it is
+// free for the producer of a given position or ready for the consumer. The slots are allocated once, when the
+// mode is enabled, so that queuing a range never allocates.
+class pending_free_queue
+{
+public:
+    static const size_t capacity = 4096;
+
+    pending_free_queue()
+        : _head(0), _tail(0)
+    {}
+
+    void reserve()
+    {
+        if (_slots) return;
+
+        _slots.reset(new slot[capacity]);
+        for (size_t i = 0; i < capacity; i++)
+        {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Queues a range. Returns false if the queue is full.
+    bool push(vaddr_t base, size_t length)
+    {
+        size_t position = _tail.load(std::memory_order_relaxed);
+        slot* s;
+        for (;;)
+        {
+            s = &_slots[position % capacity];
+            size_t sequence = s->sequence.load(std::memory_order_acquire);
+            if (sequence == position)
+            {
+                // the slot is free, take the position
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (sequence < position)
+            {
+                // the slot still holds the range queued one turn before
+                return false;
+            }
+            else
+            {
+                // another thread took the position
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        s->base = base;
+        s->length = length;
+        s->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Is a range ready to be taken by the consumer?
+    bool pending() const
+    {
+        return _slots && _slots[_head % capacity].sequence.load(std::memory_order_acquire) == _head + 1;
+    }
+
+    // Takes the oldest range. Returns false if there is none. Must only be called by the consumer.
+    bool pop(range& r)
+    {
+        if (!pending()) return false;
+
+        slot& s = _slots[_head % capacity];
+        r.base = s.base;
+        r.length = s.length;
+        s.sequence.store(_head + capacity, std::memory_order_release);
+        _head++;
+        return true;
+    }
+
+private:
+    struct slot
+    {
+        std::atomic<size_t> sequence;
+        vaddr_t             base;
+        size_t              length;
+    };
+
+    std::unique_ptr<slot[]> _slots;
+    size_t                  _head;
+    std::atomic<size_t>     _tail;
+};
+
+
+// Lock of the list of spans in deferred free mode. The thread that allocates holds it during each operation, and
+// a thread that finds the queue of deferred frees full takes it to merge the queue, so that it never waits for
+// the thread that allocates to run.
+class merge_lock
+{
+public:
+    merge_lock()
+        : _busy(false)
+    {}
+
+    bool try_lock()
+    {
+        return !_busy.exchange(true, std::memory_order_acquire);
+    }
+
+    void lock()
+    {
+        while (!try_lock())
+            std::this_thread::yield();
+    }
+
+    void unlock()
+    {
+        _busy.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic<bool> _busy;
+};
+
+
+#if !defined(RANGE_ALLOCATOR_NO_STATS)
+
+// Counters of the operations of a range allocator, reported by get_range_allocator_stats().
+// Define RANGE_ALLOCATOR_NO_STATS to compile them out.
+class operation_counters
+{
+public:
+    operation_counters()
+        : _frees(0), _visits(0)
+    {
+        for (size_t i = 0; i < RANGE_ALLOCATOR_FLAG_COUNT; i++)
+        {
+            _allocations[i] = 0;
+            _failures[i] = 0;
+        }
+        for (size_t i = 0; i < RANGE_ALLOCATOR_VISIT_BUCKETS; i++)
+        {
+            _visited[i] = 0;
+        }
+    }
+
+    // starts counting the spans visited by an operation
+    void begin()
+    {
+        _visits = 0;
+    }
+
+    void visit()
+    {
+        _visits++;
+    }
+
+    // number of spans visited by the current operation
+    size_t visits() const
+    {
+        return _visits;
+    }
+
+    void allocation(allocation_flags flags, bool success)
+    {
+        if ((size_t)flags < RANGE_ALLOCATOR_FLAG_COUNT)
+            (success ? _allocations : _failures)[flags]++;
+        end();
+    }
+
+    // counts each range of a batch, the batch is a single operation in the histogram of visited spans
+    void allocations(allocation_flags flags, size_t succeeded, size_t failed)
+    {
+        if ((size_t)flags < RANGE_ALLOCATOR_FLAG_COUNT)
+        {
+            _allocations[flags] += succeeded;
+            _failures[flags] += failed;
+        }
+        end();
+    }
+
+    void frees(size_t count)
+    {
+        _frees += count;
+        end();
+    }
+
+    void fill(range_allocator_stats& stats) const
+    {
+        for (size_t i = 0; i < RANGE_ALLOCATOR_FLAG_COUNT; i++)
+        {
+            stats.allocations[i] = _allocations[i];
+            stats.allocation_failures[i] = _failures[i];
+        }
+        stats.frees = _frees;
+        for (size_t i = 0; i < RANGE_ALLOCATOR_VISIT_BUCKETS; i++)
+        {
+            stats.visited_spans[i] = _visited[i];
+        }
+    }
+
+private:
+    // adds the operation to the histogram of visited spans
+    void end()
+    {
+        size_t bucket = 0;
+        for (size_t visits = _visits; visits && bucket + 1 < RANGE_ALLOCATOR_VISIT_BUCKETS; visits >>= 1)
+        {
+            bucket++;
+        }
+        _visited[bucket]++;
+    }
+
+    uint64_t _allocations[RANGE_ALLOCATOR_FLAG_COUNT];
+    uint64_t _failures[RANGE_ALLOCATOR_FLAG_COUNT];
+    uint64_t _frees;
+    uint64_t _visited[RANGE_ALLOCATOR_VISIT_BUCKETS];
+    size_t   _visits;
+};
+
+#else
+
+// counters compiled out: every call is a no-op
+class operation_counters
+{
+public:
+    void begin() {}
+    void visit() {}
+    size_t visits() const { return 0; }
+    void allocation(allocation_flags, bool) {}
+    void allocations(allocation_flags, size_t, size_t) {}
+    void frees(size_t) {}
+
+    void fill(range_allocator_stats& stats) const
+    {
+        for (size_t i = 0; i < RANGE_ALLOCATOR_FLAG_COUNT; i++)
+        {
+            stats.allocations[i] = 0;
+            stats.allocation_failures[i] = 0;
+        }
+        stats.frees = 0;
+        for (size_t i = 0; i < RANGE_ALLOCATOR_VISIT_BUCKETS; i++)
+        {
+            stats.visited_spans[i] = 0;
+        }
+    }
+};
+
+#endif
+
+
+// Metrics of the free space, maintained each time a span is added, removed or resized.
+// The spans are also kept in a binary max-heap ordered by length, so that the largest one is known in O(1) and
+// each update costs O(log n). Each span records its position in the heap; the heap is reserved along with the pool
+// of spans, so that updating it does not allocate.
+class free_space_metrics
+{
+public:
+    free_space_metrics()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        _free_bytes = 0;
+        _span_count = 0;
+        for (size_t i = 0; i < RANGE_ALLOCATOR_SIZE_BUCKETS; i++)
+        {
+            _buckets[i] = 0;
+        }
+        _heap.clear();
+    }
+
+    // makes room for <additional> more spans in the heap
+    void reserve(size_t additional)
+    {
+        _heap.reserve(_heap.capacity() + additional);
+    }
+
+    // adds a span that was just inserted in the list
+    void add(span* s)
+    {
+        _free_bytes += s->length;
+        _span_count++;
+        _buckets[floor_log2(s->length)]++;
+
+        s->heap_index = _heap.size();
+        _heap.push_back(s);
+        sift_up(s->heap_index);
+    }
+
+    // removes a span that is being removed from the list
+    void remove(span* s)
+    {
+        _free_bytes -= s->length;
+        _span_count--;
+        _buckets[floor_log2(s->length)]--;
+
+        size_t index = s->heap_index;
+        span* last = _heap.back();
+        _heap.pop_back();
+        if (last != s)
+        {
+            _heap[index] = last;
+            last->heap_index = index;
+            update(index);
+        }
+    }
+
+    // sets the length of a span of the list
+    void resize(span* s, size_t length)
+    {
+        _free_bytes += length - s->length;
+        _buckets[floor_log2(s->length)]--;
+        _buckets[floor_log2(length)]++;
+
+        s->length = length;
+        update(s->heap_index);
+    }
+
+    size_t free_bytes() const
+    {
+        return _free_bytes;
+    }
+
+    size_t span_count() const
+    {
+        return _span_count;
+    }
+
+    size_t bucket(size_t i) const
+    {
+        return _buckets[i];
+    }
+
+    size_t largest() const
+    {
+        return _heap.empty() ? 0 : _heap[0]->length;
+    }
+
+private:
+    // restores the order of the heap around a span whose length changed
+    void update(size_t index)
+    {
+        if (index > 0 && _heap[index]->length > _heap[(index - 1) / 2]->length)
+            sift_up(index);
+        else
+            sift_down(index);
+    }
+
+    void sift_up(size_t index)
+    {
+        span* s = _heap[index];
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / 2;
+            if (_heap[parent]->length >= s->length) break;
+
+            _heap[index] = _heap[parent];
+            _heap[index]->heap_index = index;
+            index = parent;
+        }
+        _heap[index] = s;
+        s->heap_index = index;
+    }
+
+    void sift_down(size_t index)
+    {
+        span* s = _heap[index];
+        for (;;)
+        {
+            size_t child = 2 * index + 1;
+            if (child >= _heap.size()) break;
+            if (child + 1 < _heap.size() && _heap[child + 1]->length > _heap[child]->length) child++;
+            if (s->length >= _heap[child]->length) break;
+
+            _heap[index] = _heap[child];
+            _heap[index]->heap_index = index;
+            index = child;
+        }
+        _heap[index] = s;
+        s->heap_index = index;
+    }
+
+    size_t             _free_bytes;
+    size_t             _span_count;
+    size_t             _buckets[RANGE_ALLOCATOR_SIZE_BUCKETS];
+    std::vector<span*> _heap;
+};
+
+
+template <class SpanAllocator>
+class range_allocator
+{
+public:
+    // Construct a new instance.
+    // The stored length value is the size of the memory range that is effectively accessible given
+    // the provided granularity. It can be smaller than or equal to the provided length value.
+    // It grows with the regions added later on.
+    range_allocator(vaddr_t base, size_t length, size_t granularity)
+        : _base(base), _length(length), _granularity(granularity), _spans(((length / granularity) + 1) / 2)
+        , _placement(PLACEMENT_DEFAULT), _deferred_free(false)
+    {
+        // adjust the base address on next granularity bound
+        // correct length in consequence
+        //_base = ((base + _granularity - 1) / _granularity) * _granularity;
+        //_length = length - (_base - base);
+
+        // align the corrected length on previous granularity bound
+        _length = (_length / _granularity) * _granularity;
+
+        range r = { _base, _length };
+        _regions.push_back(r);
+
+        span* s = add_span();
+        s->base = _base;
+        s->length = _length;
+        s->next = 0;
+        _metrics.reserve(((length / granularity) + 1) / 2);
+        _metrics.add(s);
+
+        _free_mem_root.next = s;
+    }
+
+    ~range_allocator()
+    {
+        discard_pending();
+
+        // Release all used spans and let the span allocator manage its destruction
+        while (_free_mem_root.next)
+        {
+            span* s = _free_mem_root.next;
+            _free_mem_root.next = _free_mem_root.next->next;
+            _spans.release(s);
+        }
+    }
+
+    // Frees the whole range at once: all the spans are given back to the span manager in bulk, and the list is
+    // seeded with a single span per region.
+    void reset()
+    {
+        list_guard guard(*this);
+        discard_pending();
+
+        _spans.release_all(_free_mem_root.next);
+        _metrics.clear();
+
+        span* curr = &_free_mem_root;
+        for (size_t i = 0; i < _regions.size(); i++)
+        {
+            span* s = add_span();
+            s->base = _regions[i].base;
+            s->length = _regions[i].length;
+            _metrics.add(s);
+            curr->next = s;
+            curr = s;
+        }
+        curr->next = 0;
+    }
+
+    // Adds a disjoint region to the managed ranges. The region is free and is managed on the same granularity
+    // grid as the first one; spans never span two regions, even if they are adjacent.
+    // Returns false if the region is empty, not on the grid or overlaps a region that is already managed.
+    bool add_region(vaddr_t base, size_t length)
+    {
+        length = (length / _granularity) * _granularity;
+
+        if (length == 0) return false;
+        if (base % _granularity != _base % _granularity) return false;
+        if (base + length < base) return false;
+
+        // regions are sorted by base address
+        std::vector<range>::iterator it = std::upper_bound(_regions.begin(), _regions.end(), base, region_order());
+        if (it != _regions.end() && base + length > it->base) return false;
+        if (it != _regions.begin() && (it - 1)->base + (it - 1)->length > base) return false;
+
+        list_guard guard(*this);
+        _spans.grow(((length / _granularity) + 1) / 2);
+        _metrics.reserve(((length / _granularity) + 1) / 2);
+
+        range r = { base, length };
+        _regions.insert(it, r);
+        _length += length;
+
+        span* curr = &_free_mem_root;
+        free_after(curr, base, length);
+        return true;
+    }
+
+    // Grows the range given at construction by <additional_length> bytes at its end, for instance when the
+    // address space that follows it is reserved as well. The new tail is free: it is merged into the last span
+    // of the range if that one is adjacent.
+    // Returns false if the tail is empty or overlaps a region that is already managed.
+    bool extend(size_t additional_length)
+    {
+        additional_length = (additional_length / _granularity) * _granularity;
+        if (additional_length == 0) return false;
+
+        std::vector<range>::iterator it = std::lower_bound(_regions.begin(), _regions.end(), _base, region_order());
+        vaddr_t end = it->base + it->length;
+        if (end + additional_length < end) return false;
+        if (it + 1 != _regions.end() && end + additional_length > (it + 1)->base) return false;
+
+        list_guard guard(*this);
+        _spans.grow(((additional_length / _granularity) + 1) / 2);
+        _metrics.reserve(((additional_length / _granularity) + 1) / 2);
+
+        it->length += additional_length;
+        _length += additional_length;
+
+        span* curr = &_free_mem_root;
+        free_after(curr, end, additional_length);
+        return true;
+    }
+
+    // Allocates a range, optionally aligned on <alignment> bytes (a multiple of the granularity).
+    vaddr_t allocate(size_t length, allocation_flags flags, vaddr_t hint, size_t alignment = 0)
+    {
+        RANGE_ALLOCATOR_PROBE3(allocate__entry, length, flags, hint);
+        operation_timer timer(latency_of(flags));
+        list_guard guard(*this);
+        _counters.begin();
+        vaddr_t base = find_range(length, flags, hint, alignment);
+        RANGE_ALLOCATOR_PROBE4(allocate__return, length, flags, base, _counters.visits());
+        _counters.allocation(flags, base != (vaddr_t)-1);
+        return base;
+    }
+
+    // Allocates a range that resides entirely in [lo, hi), at the lowest possible address.
+    // It is counted as an ALLOCATE_ANY allocation.
+    vaddr_t allocate_between(size_t length, vaddr_t lo, vaddr_t hi)
+    {
+        list_guard guard(*this);
+        _counters.begin();
+        vaddr_t base = find_between(length, lo, hi);
+        _counters.allocation(ALLOCATE_ANY, base != (vaddr_t)-1);
+        return base;
+    }
+
+    // Grows or shrinks in place an allocated range. The range can only grow into the free span that directly
+    // follows it, in the same region. Returns the base address of the range, or (vaddr_t)-1 if the range cannot be resized in place.
+    vaddr_t resize(vaddr_t base, size_t old_length, size_t new_length)
+    {
+        // Align lengths to the upper granularity boundary
+        old_length = ((old_length + _granularity - 1) / _granularity) * _granularity;
+        new_length = ((new_length + _granularity - 1) / _granularity) * _granularity;
+
+        if (old_length == 0 || new_length == 0) return (vaddr_t)-1;
+        if (!in_region(base, old_length)) return (vaddr_t)-1;
+        if (new_length == old_length) return base;
+
+        if (new_length < old_length)
+        {
+            // give the tail back to the free list
+            free(base + new_length, old_length - new_length);
+            return base;
+        }
+
+        // merge the ranges released in deferred mode before looking for the following span
+        list_guard guard(*this);
+        if (_pending_frees.pending())
+            merge_pending();
+        _counters.begin();
+
+        // the growth is counted as an ALLOCATE_EXACT allocation of the tail
+        bool grown = grow(base, old_length, new_length);
+        _counters.allocation(ALLOCATE_EXACT, grown);
+        return grown ? base : (vaddr_t)-1;
+    }
+
+    // Allocates up to <count> ranges of <length> bytes in a single walk of the list, carving as many
+    // consecutive ranges as possible from each span before moving to the next one.
+    // With ALLOCATE_EXACT, the ranges are consecutive and start at the hint. With ALLOCATE_NEAR, and with
+    // ALLOCATE_BELOW in hint-local placement, each range is placed in turn as close to the hint as possible, with a
+    // walk of the list per range.
+    // Returns the number of allocated ranges; the other entries of <bases> are set to (vaddr_t)-1.
+    size_t allocate_many(size_t length, size_t count, allocation_flags flags, vaddr_t hint, vaddr_t* bases)
+    {
+        // Align the length to the upper granularity boundary
+        length = ((length + _granularity - 1) / _granularity) * _granularity;
+
+        // merge the ranges released in deferred mode before looking for spans
+        list_guard guard(*this);
+        if (_pending_frees.pending())
+            merge_pending();
+        _counters.begin();
+
+        size_t allocated = 0;
+        if (length != 0 && length <= _length)
+        {
+            // the placement closest to the hint depends on the ranges already allocated: one walk per range
+            bool closest = (flags == ALLOCATE_NEAR || (flags == ALLOCATE_BELOW && _placement == PLACEMENT_HINT_LOCAL));
+            while (closest && allocated < count)
+            {
+                vaddr_t base = (flags == ALLOCATE_NEAR) ? allocate_near(length, hint, 0) : allocate_below_hint(length, hint, 0);
+                if (base == (vaddr_t)-1)
+                    break;
+                bases[allocated++] = base;
+            }
+
+            span* previous = &_free_mem_root;
+            span* current = closest ? 0 : _free_mem_root.next;
+            while (current && allocated < count)
+            {
+                _counters.visit();
+                if (check_span(current, length, flags, hint))
+                {
+                    // part of the span that can be used for the request
+                    vaddr_t begin = current->base;
+                    vaddr_t end = current->base + current->length;
+                    if (flags == ALLOCATE_EXACT || (flags == ALLOCATE_ABOVE && begin < hint)) begin = hint;
+                    if (flags == ALLOCATE_BELOW && end > hint) end = hint;
+                    if (flags == ALLOCATE_ABOVE && _placement == PLACEMENT_HINT_LOCAL)
+                        begin = hint_local_base(current, length, flags, hint, 0);
+
+                    size_t n = (end - begin) / length;
+                    if (n > count - allocated) n = count - allocated;
+
+                    // carve all the ranges at once, as a single allocation
+                    bool removed = (n * length == current->length);
+                    vaddr_t base = split_span(previous, current, n * length, flags, hint);
+                    if (base == (vaddr_t)-1)
+                        break;
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        bases[allocated++] = base + i * length;
+                    }
+
+                    if (flags == ALLOCATE_EXACT)
+                        break;
+                    if (removed)
+                    {
+                        // the span was unlinked: the following one is now linked to the previous span
+                        current = previous->next;
+                        continue;
+                    }
+                }
+
+                // the link is read again: a split in the middle of the span inserted its upper part after it
+                previous = current;
+                current = current->next;
+            }
+        }
+
+        for (size_t i = allocated; i < count; i++)
+        {
+            bases[i] = (vaddr_t)-1;
+        }
+        _counters.allocations(flags, allocated, count - allocated);
+        return allocated;
+    }
+
+    void free(vaddr_t base, size_t length)
+    {
+        RANGE_ALLOCATOR_PROBE2(free__entry, base, length);
+        if (_deferred_free.load(std::memory_order_acquire))
+        {
+            // only queue the range: it is merged by the next call to allocate() or flush()
+            defer(base, length);
+            return;
+        }
+
+        operation_timer timer(latency_of(RANGE_ALLOCATOR_LATENCY_FREE));
+        _counters.begin();
+        span* curr = &_free_mem_root;
+        free_after(curr, base, length);
+        _counters.frees(1);
+    }
+
+    // First free span, the list is ordered by increasing base address.
+    const span* first_span() const
+    {
+        return _free_mem_root.next;
+    }
+
+    // Fills the counters and the state of the free space.
+    void stats(range_allocator_stats& stats) const
+    {
+        list_guard guard(*this);
+        _counters.fill(stats);
+
+        stats.span_count = _metrics.span_count();
+        stats.free_bytes = _metrics.free_bytes();
+        stats.largest_free_span = _metrics.largest();
+        stats.span_pool_high_water = _spans.high_water();
+    }
+
+    // Reports the metrics of the free space.
+    void fragmentation(range_allocator_fragmentation& fragmentation) const
+    {
+        list_guard guard(*this);
+        fragmentation.free_bytes = _metrics.free_bytes();
+        fragmentation.largest_free_span = _metrics.largest();
+        fragmentation.span_count = _metrics.span_count();
+        for (size_t i = 0; i < RANGE_ALLOCATOR_SIZE_BUCKETS; i++)
+        {
+            fragmentation.spans_by_size[i] = _metrics.bucket(i);
+        }
+        fragmentation.ratio = fragmentation.free_bytes ? 1.0 - (double)fragmentation.largest_free_span / fragmentation.free_bytes : 0.0;
+    }
+
+    // Calls the visitor for each free span, in increasing address order.
+    void visit_spans(range_allocator_span_visitor visitor, void* context) const
+    {
+        list_guard guard(*this);
+        for (const span* s = _free_mem_root.next; s; s = s->next)
+        {
+            visitor(context, s->base, s->length);
+        }
+    }
+
+    // Fills <count> buckets with the ratio of free memory in successive windows of equal size, from the lowest
+    // to the highest address of the regions, scaled from 0 (allocated) to 255 (free). Each span is visited
+    // once per bucket it overlaps.
+    void free_map(uint8_t* map, size_t count) const
+    {
+        if (count == 0) return;
+
+        list_guard guard(*this);
+        vaddr_t first = _regions.front().base;
+        vaddr_t last = _regions.back().base + _regions.back().length;
+        size_t window = (last - first + count - 1) / count;
+
+        const span* s = _free_mem_root.next;
+        for (size_t i = 0; i < count; i++)
+        {
+            vaddr_t lo = first + i * window;
+            if (lo >= last)
+            {
+                map[i] = 0;
+                continue;
+            }
+            vaddr_t hi = (last - lo > window) ? lo + window : last;
+
+            // w          lo|--------------|hi
+            // s     |---------|      |-------------|
+            //                 ^^^^^^ ^^^^^^
+            while (s && s->base + s->length <= lo)
+            {
+                s = s->next;
+            }
+            size_t free = 0;
+            for (const span* t = s; t && t->base < hi; t = t->next)
+            {
+                vaddr_t begin = (t->base > lo) ? t->base : lo;
+                vaddr_t end = (t->base + t->length < hi) ? t->base + t->length : hi;
+                free += end - begin;
+            }
+            map[i] = (uint8_t)((double)free * 255 / (hi - lo) + 0.5);
+        }
+    }
+
+    // Enables or disables the timing of allocate() and free(). The histograms are allocated when it is enabled.
+    void set_latency_tracking(bool enable)
+    {
+        if (enable && _latencies.empty())
+            _latencies.resize(RANGE_ALLOCATOR_LATENCY_FREE + 1);
+        if (!enable)
+            std::vector<latency_histogram>().swap(_latencies);
+    }
+
+    // Histogram of the latencies of an operation, 0 if the timing is disabled.
+    const latency_histogram* latency(size_t operation) const
+    {
+        if (operation > RANGE_ALLOCATOR_LATENCY_FREE || _latencies.empty()) return 0;
+        return &_latencies[operation];
+    }
+
+    void reset_latency()
+    {
+        for (size_t i = 0; i < _latencies.size(); i++)
+        {
+            _latencies[i].reset();
+        }
+    }
+
+    // Sets the placement of ALLOCATE_ABOVE and ALLOCATE_BELOW requests.
+    void set_placement(placement_policy placement)
+    {
+        _placement = placement;
+    }
+
+    // Gives access to the span manager, e.g. to control the placement of its memory.
+    SpanAllocator& span_manager()
+    {
+        return _spans;
+    }
+
+    // Releases several ranges. They are sorted by base address, so that they can be merged in a single walk of the list.
+    void free_many(const range* ranges, size_t count)
+    {
+        if (count == 0) return;
+
+        if (_deferred_free.load(std::memory_order_acquire))
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                defer(ranges[i].base, ranges[i].length);
+            }
+            return;
+        }
+
+        _sorted_ranges.assign(ranges, ranges + count);
+        std::sort(_sorted_ranges.begin(), _sorted_ranges.end(), range_less);
+
+        _counters.begin();
+        span* curr = &_free_mem_root;
+        for (size_t i = 0; i < count; i++)
+        {
+            free_after(curr, _sorted_ranges[i].base, _sorted_ranges[i].length);
+        }
+        _counters.frees(count);
+    }
+
+    // Enables or disables the deferred free mode. Pending ranges are merged when the mode is disabled.
+    // Ranges released after the mode is disabled must not be freed concurrently with the other calls.
+    void set_deferred_free(bool enable)
+    {
+        if (enable)
+        {
+            _pending_frees.reserve();
+            _sorted_ranges.reserve(pending_free_queue::capacity);
+            _deferred_free.store(true, std::memory_order_release);
+            return;
+        }
+
+        // merge while the mode is still on, so that a thread that finds the queue full waits for the merge lock
+        list_guard guard(*this);
+        merge_pending();
+        _deferred_free.store(false, std::memory_order_release);
+    }
+
+    // Merges all the ranges queued in deferred free mode.
+    void flush()
+    {
+        list_guard guard(*this);
+        merge_pending();
+    }
+
+private:
+
+    // Holds the merge lock during an operation on the list of spans, if the deferred free mode is enabled.
+    class list_guard
+    {
+    public:
+        explicit list_guard(const range_allocator& allocator)
+            : _lock(allocator._deferred_free.load(std::memory_order_acquire) ? &allocator._merge_lock : 0)
+        {
+            if (_lock) _lock->lock();
+        }
+
+        ~list_guard()
+        {
+            if (_lock) _lock->unlock();
+        }
+
+    private:
+        list_guard(const list_guard&);
+        list_guard& operator=(const list_guard&);
+
+        merge_lock* _lock;
+    };
+
+    // Merges the ranges queued in deferred free mode, the merge lock must be held.
+    // The batch is sorted by base address so that it can be merged in a single walk of the list.
+    void merge_pending()
+    {
+        range r;
+        _sorted_ranges.clear();
+        for (size_t i = 0; i < pending_free_queue::capacity && _pending_frees.pop(r); i++)
+        {
+            _sorted_ranges.push_back(r);
+        }
+        if (_sorted_ranges.empty()) return;
+
+        std::sort(_sorted_ranges.begin(), _sorted_ranges.end(), range_less);
+
+        _counters.begin();
+        span* curr = &_free_mem_root;
+        for (size_t i = 0; i < _sorted_ranges.size(); i++)
+        {
+            free_after(curr, _sorted_ranges[i].base, _sorted_ranges[i].length);
+        }
+        _counters.frees(_sorted_ranges.size());
+    }
+
+    // histogram where the latency of an operation is recorded, 0 if the timing is disabled
+    latency_histogram* latency_of(size_t operation)
+    {
+        if (_latencies.empty() || operation > RANGE_ALLOCATOR_LATENCY_FREE) return 0;
+        return &_latencies[operation];
+    }
+
+    // Looks for the lowest range in [lo, hi) and allocates it.
+    vaddr_t find_between(size_t length, vaddr_t lo, vaddr_t hi)
+    {
+        // Align the length to the upper granularity boundary
+        length = ((length + _granularity - 1) / _granularity) * _granularity;
+
+        if (length == 0) return (vaddr_t)-1;
+        if (length > _length) return (vaddr_t)-1;
+
+        // the window starts on a block of the range
+        vaddr_t origin = _regions.front().base;
+        if (lo < origin) lo = origin;
+        lo = origin + ((lo - origin + _granularity - 1) / _granularity) * _granularity;
+        if (hi <= lo || hi - lo < length) return (vaddr_t)-1;
+
+        // merge the ranges released in deferred mode before looking for a span
+        if (_pending_frees.pending())
+            merge_pending();
+        _counters.begin();
+
+        // the walk stops at the first span beyond the window
+        span* previous = &_free_mem_root;
+        for (span* current = _free_mem_root.next; current && current->base + length <= hi; previous = current, current = current->next)
+        {
+            _counters.visit();
+
+            // w           lo'-----------------'hi
+            // s     |------------|      |---------------|
+            //                           ^^^^^
+            vaddr_t begin = (current->base > lo) ? current->base : lo;
+            vaddr_t end = (current->base + current->length < hi) ? current->base + current->length : hi;
+            if (end > begin && end - begin >= length)
+                return trunc_span_at(previous, current, begin, length) ? begin : (vaddr_t)-1;
+        }
+
+        // no available block
+        return (vaddr_t)-1;
+    }
+
+    // Allocates the free memory that directly follows a range, so that it grows to <new_length> bytes.
+    bool grow(vaddr_t base, size_t old_length, size_t new_length)
+    {
+        // a range never grows across the end of its region, even into an adjacent one
+        if (!in_region(base, new_length)) return false;
+
+        // range |------------|
+        // s                  |--------------|
+        //                    ^^^^^
+        vaddr_t end = base + old_length;
+        span* previous = &_free_mem_root;
+        span* current = _free_mem_root.next;
+        while (current && current->base < end)
+        {
+            _counters.visit();
+            previous = current;
+            current = current->next;
+        }
+        if (current) _counters.visit();
+
+        if (!current || current->base != end || current->length < new_length - old_length)
+            return false;
+
+        trunc_span_low(previous, current, new_length - old_length);
+        return true;
+    }
+
+    // Looks for a span that matches the request and allocates the range in it.
+    vaddr_t find_range(size_t length, allocation_flags flags, vaddr_t hint, size_t alignment)
+    {
+        // Align the length to the upper granularity boundary
+        length = ((length + _granularity - 1) / _granularity) * _granularity;
+
+        if (length == 0) return (vaddr_t)-1;
+        if (length > _length) return (vaddr_t)-1;
+
+        // any allocation is aligned on the granularity
+        if (alignment <= _granularity) alignment = 0;
+        if (alignment % _granularity) return (vaddr_t)-1;
+
+        // merge the ranges released in deferred mode before looking for a span
+        if (_pending_frees.pending())
+            merge_pending();
+        _counters.begin();
+
+        if (flags == ALLOCATE_NEAR)
+            return allocate_near(length, hint, alignment);
+        if (flags == ALLOCATE_BELOW && _placement == PLACEMENT_HINT_LOCAL)
+            return allocate_below_hint(length, hint, alignment);
+
+        // find the first span that match the request
+        span* previous = &_free_mem_root;
+        span* current = _free_mem_root.next;
+        while (current)
+        {
+            _counters.visit();
+            if (check_span(current, length, flags, hint, alignment))
+                break;
+
+            previous = current;
+            current = current->next;
+        }
+        
+        // no available block
+        if (!current) return (vaddr_t)-1;
+
+        // truncate the found span and get the base allocation
+        return split_span(previous, current, length, flags, hint, alignment);
+    }
+
+    // Releases a range, looking for its position in the list after the span <curr>.
+    // On return, <curr> is a span located before the released range, so that a following range with a
+    // greater base address can be released starting from it.
+    void free_after(span*& curr, vaddr_t base, size_t length)
+    {
+        // Align base and length on granularity.
+        // Maybe an error if base is not aligned as this should be a value returned by the allocator.
+        base   = (base / _granularity) * _granularity;
+        length = ((length + _granularity - 1) / _granularity) * _granularity;
+
+        if (length == 0) return;
+        if (!in_region(base, length)) return; // the range to free must be contained entirely in a region
+        
+        //
+        span* next = curr->next;
+        while (next)
+        {
+            _counters.visit();
+
+            //    curr                        next              
+            // |--------|..................|--------|...........
+            //                   |-------|                      
+            if (base + length < next->base)
+            {
+                // include a new span in the list
+                span* s = add_span();
+                if (!s) return; // no span available, the range is lost
+                s->base = base;
+                s->length = length;
+                s->next = next;
+                curr->next = s;
+                _metrics.add(s);
+                return;
+            }
+
+            //    curr                        next              
+            // |--------|..................|--------|...........
+            //                     |-------|                    
+            if (base + length == next->base && is_region_start(next->base))
+            {
+                // the next span starts a region: include a new span in the list
+                span* s = add_span();
+                if (!s) return; // no span available, the range is lost
+                s->base = base;
+                s->length = length;
+                s->next = next;
+                curr->next = s;
+                _metrics.add(s);
+                return;
+            }
+            if (base + length == next->base)
+            {
+                // merge the free region at the beginning of the next span
+                _metrics.resize(next, next->length + length);
+                next->base = base;
+                RANGE_ALLOCATOR_PROBE2(free__merge, next->base, next->length);
+                return;
+            }
+
+            //    curr                        next              
+            // |--------|..................|--------|...........
+            //                         |-------|                
+            //                           |--------------|       
+            //                                   |-------|       
+            if (base < next->base + next->length)
+            {
+                // intersection is not empty: treat this as an error
+                return;
+            }
+
+
+            //    curr                        next              
+            // |--------|..................|--------|...........
+            //                                      |-------|   
+            if (base == next->base + next->length && !is_region_start(base))
+            {
+                // check any overlap with next next
+                if (next->next)
+                {
+                    //    next           next->next        
+                    // |--------|........|--------|
+                    //          |------------|   
+                    if (base + length > next->next->base)
+                    {
+                        // intersection is not empty: treat this as an error
+                        return;
+                    }
+
+                    //    next           next->next        
+                    // |--------|........|--------|
+                    //          |--------|   
+                    if (base + length == next->next->base && !is_region_start(next->next->base))
+                    {
+                        // merge with next span
+                        _metrics.resize(next, next->length + length + next->next->length);
+                        remove_span(next, next->next);
+                        RANGE_ALLOCATOR_PROBE2(free__merge, next->base, next->length);
+                        return;
+                    }
+                }
+
+                // merge the free region at the end of the next span
+                _metrics.resize(next, next->length + length);
+                RANGE_ALLOCATOR_PROBE2(free__merge, next->base, next->length);
+                return;
+            }
+
+            //    curr                        next              
+            // |--------|..................|--------|...........
+            //                                        |-------| 
+            //if (base > next->base + next->length)
+
+            curr = next;
+            next = next->next;
+        }
+
+        // no more span, include a new one at the end of the list
+        span* s = add_span();
+        if (!s) return; // no span available, the range is lost
+        s->base = base;
+        s->length = length;
+        s->next = 0;
+        curr->next = s;
+        _metrics.add(s);
+    }
+
+    // orders the regions and the addresses by base address
+    struct region_order
+    {
+        bool operator()(vaddr_t base, const range& r) const { return base < r.base; }
+        bool operator()(const range& r, vaddr_t base) const { return r.base < base; }
+    };
+
+    // check that the range is contained entirely in one of the regions
+    bool in_region(vaddr_t base, size_t length) const
+    {
+        std::vector<range>::const_iterator it = std::upper_bound(_regions.begin(), _regions.end(), base, region_order());
+        if (it == _regions.begin()) return false;
+        --it;
+        return base < it->base + it->length && length <= it->base + it->length - base;
+    }
+
+    // spans are never merged across the start of a region
+    bool is_region_start(vaddr_t base) const
+    {
+        if (_regions.size() == 1) return false;
+        return std::binary_search(_regions.begin(), _regions.end(), base, region_order());
+    }
+
+    // discard the ranges queued in deferred free mode that were never merged
+    void discard_pending()
+    {
+        range r;
+        while (_pending_frees.pop(r))
+            ;
+    }
+
+    static bool range_less(const range& a, const range& b)
+    {
+        return a.base < b.base;
+    }
+
+    // Queues a range released in deferred free mode. When the queue is full, the calling thread merges it if
+    // the list is not in use, and waits for the thread that holds the list otherwise.
+    void defer(vaddr_t base, size_t length)
+    {
+        while (!_pending_frees.push(base, length))
+        {
+            if (_merge_lock.try_lock())
+            {
+                merge_pending();
+                _merge_lock.unlock();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    span* add_span()
+    {
+        span* s = _spans.get();
+        if (!s) RANGE_ALLOCATOR_PROBE0(span__exhausted);
+        return s;
+    }
+
+    void remove_span(span* prev, span* curr)
+    {
+        _metrics.remove(curr);
+        prev->next = curr->next;
+        _spans.release(curr);
+    }
+
+    // check if the span satisfy the constraints
+    bool check_span(span* s, size_t length, allocation_flags flags, vaddr_t hint, size_t alignment = 0)
+    {
+        if (alignment)
+            return aligned_base(s, length, flags, hint, alignment) != (vaddr_t)-1;
+        if (_placement == PLACEMENT_HINT_LOCAL && (flags == ALLOCATE_ABOVE || flags == ALLOCATE_BELOW))
+            return hint_local_base(s, length, flags, hint, 0) != (vaddr_t)-1;
+
+        switch (flags)
+        {
+        case ALLOCATE_ANY:
+            // need any span that has more than <length> bytes
+            return (s->length >= length);
+
+        case ALLOCATE_EXACT:
+            // need a span that contains entirely [hint, hint+length[
+            return (s->base <= hint) && (hint + length <= s->base + s->length);
+
+        case ALLOCATE_ABOVE:
+            if (s->base >= hint)
+            {
+                // _____'_____-----------_________
+                //                   ^^^^         
+                return (s->length >= length);
+            }
+            else if (s->base + s->length >= hint)
+            {
+                // ___________----'------_________
+                //                   ^^^^         
+                return (s->base + s->length >= hint + length);
+            }
+            return false;
+
+        case ALLOCATE_BELOW:
+            // s    |----------------h------------|
+            //      |----------|                   
+            return (s->base + length <= hint) && (s->length >= length);
+
+        case ALLOCATE_NEAR:
+            // any span that is large enough, the best one is selected by allocate_near()
+            return (s->length >= length);
+        }
+        return false;
+    }
+
+    // get the base address of the range placed in the span as close as possible to the hint,
+    // on the granularity (relative to the base of the allocator) or on the alignment
+    vaddr_t near_base(span* s, size_t length, vaddr_t hint, size_t alignment)
+    {
+        if (s->length < length) return (vaddr_t)-1;
+
+        vaddr_t origin = alignment ? 0 : _base % _granularity;
+        size_t  step = alignment ? alignment : _granularity;
+
+        // lowest and highest possible base addresses in the span
+        vaddr_t lowest = origin + ((s->base - origin + step - 1) / step) * step;
+        vaddr_t highest = origin + ((s->base + s->length - length - origin) / step) * step;
+        if (lowest > highest) return (vaddr_t)-1;
+
+        // s     |----------h--------------| 
+        // alloc        |------------|
+        if (hint <= lowest) return lowest;
+        if (hint >= highest) return highest;
+
+        vaddr_t below = origin + ((hint - origin) / step) * step;
+        vaddr_t above = (below == hint) ? hint : below + step;
+        return (hint - below <= above - hint) ? below : above;
+    }
+
+    // find the placement that is the closest to the hint in the whole list
+    vaddr_t allocate_near(size_t length, vaddr_t hint, size_t alignment)
+    {
+        span*   best_previous = 0;
+        span*   best = 0;
+        vaddr_t best_base = (vaddr_t)-1;
+        size_t  best_distance = (size_t)-1;
+
+        span* previous = &_free_mem_root;
+        for (span* current = _free_mem_root.next; current; previous = current, current = current->next)
+        {
+            _counters.visit();
+
+            // the following spans are even farther above the hint
+            if (current->base > hint && current->base - hint >= best_distance)
+                break;
+
+            vaddr_t base = near_base(current, length, hint, alignment);
+            if (base == (vaddr_t)-1)
+                continue;
+
+            size_t distance = (base > hint) ? base - hint : hint - base;
+            if (distance < best_distance)
+            {
+                best_previous = previous;
+                best = current;
+                best_base = base;
+                best_distance = distance;
+            }
+        }
+
+        // no available block
+        if (!best) return (vaddr_t)-1;
+
+        return trunc_span_at(best_previous, best, best_base, length) ? best_base : (vaddr_t)-1;
+    }
+
+    // get the base address of a range placed in the span as close as possible to the hint, above or below it
+    // depending on the flags, or (vaddr_t)-1 if the span cannot contain it
+    vaddr_t hint_local_base(span* s, size_t length, allocation_flags flags, vaddr_t hint, size_t alignment)
+    {
+        if (s->length < length) return (vaddr_t)-1;
+
+        vaddr_t origin = alignment ? 0 : _base % _granularity;
+        size_t  step = alignment ? alignment : _granularity;
+
+        vaddr_t base = (vaddr_t)-1;
+        if (flags == ALLOCATE_ABOVE)
+        {
+            // s     |-----h-----------------| 
+            // alloc       |------------|
+            vaddr_t lowest = (s->base > hint) ? s->base : hint;
+            base = origin + ((lowest - origin + step - 1) / step) * step;
+        }
+        else
+        {
+            // s     |-----------------h-----| 
+            // alloc     |------------|
+            vaddr_t end = (s->base + s->length < hint) ? s->base + s->length : hint;
+            if (end < s->base + length) return (vaddr_t)-1;
+            base = origin + ((end - length - origin) / step) * step;
+        }
+
+        if (base < s->base || base + length > s->base + s->length) return (vaddr_t)-1;
+        return base;
+    }
+
+    // find the last span that can hold the range below the hint, that is the closest to the hint
+    vaddr_t allocate_below_hint(size_t length, vaddr_t hint, size_t alignment)
+    {
+        span* found_previous = 0;
+        span* found = 0;
+
+        span* previous = &_free_mem_root;
+        for (span* current = _free_mem_root.next; current && current->base < hint; previous = current, current = current->next)
+        {
+            _counters.visit();
+            if (check_span(current, length, ALLOCATE_BELOW, hint, alignment))
+            {
+                found_previous = previous;
+                found = current;
+            }
+        }
+
+        // no available block
+        if (!found) return (vaddr_t)-1;
+
+        return split_span(found_previous, found, length, ALLOCATE_BELOW, hint, alignment);
+    }
+
+    // get the base address of an aligned range placed in the span according to the flags,
+    // or (vaddr_t)-1 if the span cannot contain it
+    vaddr_t aligned_base(span* s, size_t length, allocation_flags flags, vaddr_t hint, size_t alignment)
+    {
+        if (s->length < length) return (vaddr_t)-1;
+
+        if (_placement == PLACEMENT_HINT_LOCAL && (flags == ALLOCATE_ABOVE || flags == ALLOCATE_BELOW))
+            return hint_local_base(s, length, flags, hint, alignment);
+
+        vaddr_t base = (vaddr_t)-1;
+        switch (flags)
+        {
+        case ALLOCATE_ANY:
+        case ALLOCATE_BELOW:
+            // s     |---'---------'-------'----| 
+            // alloc     |------------|
+            base = ((s->base + alignment - 1) / alignment) * alignment;
+            if (flags == ALLOCATE_BELOW && base + length > hint) return (vaddr_t)-1;
+            break;
+
+        case ALLOCATE_EXACT:
+            if (hint % alignment) return (vaddr_t)-1;
+            base = hint;
+            break;
+
+        case ALLOCATE_ABOVE:
+            // s     |---'---------'-------'----| 
+            // alloc               |------------|
+            base = ((s->base + s->length - length) / alignment) * alignment;
+            if (base < hint) return (vaddr_t)-1;
+            break;
+
+        case ALLOCATE_NEAR:
+            base = near_base(s, length, hint, alignment);
+            break;
+        }
+
+        if (base < s->base || base + length > s->base + s->length) return (vaddr_t)-1;
+        return base;
+    }
+
+    // truncate the current span of <length> bytes on the lower addresses
+    void trunc_span_low(span* prev, span* curr, size_t length)
+    {
+        if (length == curr->length)
+        {
+            remove_span(prev, curr);
+        }
+        else
+        {
+            _metrics.resize(curr, curr->length - length);
+            curr->base += length;
+        }
+    }
+
+    // truncate the current span of <length> bytes on the higher addresses
+    void trunc_span_high(span* prev, span* curr, size_t length)
+    {
+        if (length == curr->length)
+        {
+            remove_span(prev, curr);
+        }
+        else
+        {
+            _metrics.resize(curr, curr->length - length);
+        }
+    }
+
+    // truncate the current span of <length> bytes starting at <base>
+    // returns false if there is no span available to hold the upper part
+    bool trunc_span_middle(span* prev, span* curr, vaddr_t base, size_t length)
+    {
+        if (length == curr->length)
+        {
+            remove_span(prev, curr);
+        }
+        else
+        {
+            span* s = add_span();
+            if (!s) return false;
+
+            RANGE_ALLOCATOR_PROBE4(split, curr->base, curr->length, base, length);
+            s->base = base + length;
+            s->length = curr->base + curr->length - s->base;
+            s->next = curr->next;
+            _metrics.resize(curr, base - curr->base);
+            _metrics.add(s);
+
+            curr->next = s;
+        }
+        return true;
+    }
+
+    // truncate the current span of <length> bytes starting at <base>, anywhere in the span
+    bool trunc_span_at(span* prev, span* curr, vaddr_t base, size_t length)
+    {
+        if (curr->base == base)
+        {
+            // curr  b---------------------| 
+            // alloc |------------|
+            trunc_span_low(prev, curr, length);
+        }
+        else if (base + length == curr->base + curr->length)
+        {
+            // curr  |--------b------------| 
+            // alloc          |------------|
+            trunc_span_high(prev, curr, length);
+        }
+        else
+        {
+            // curr  |-----b---------------| 
+            // alloc       |------------|
+            return trunc_span_middle(prev, curr, base, length);
+        }
+        return true;
+    }
+
+    // remove a sub-span from the current span
+    vaddr_t split_span(span* prev, span* curr, size_t length, allocation_flags flags, vaddr_t hint, size_t alignment = 0)
+    {
+        vaddr_t base = (vaddr_t )-1;
+        if (alignment)
+        {
+            // the slack before and after the aligned range stays free
+            base = aligned_base(curr, length, flags, hint, alignment);
+            return trunc_span_at(prev, curr, base, length) ? base : (vaddr_t)-1;
+        }
+        if (_placement == PLACEMENT_HINT_LOCAL && (flags == ALLOCATE_ABOVE || flags == ALLOCATE_BELOW))
+        {
+            // the range is placed next to the hint
+            base = hint_local_base(curr, length, flags, hint, 0);
+            if (base == (vaddr_t)-1) return base;
+            return trunc_span_at(prev, curr, base, length) ? base : (vaddr_t)-1;
+        }
+
+        switch (flags)
+        {
+        case ALLOCATE_ANY:
+            // curr  |---------------------| 
+            // alloc |------------|
+            base = curr->base;
+            trunc_span_low(prev, curr, length);
+            break;
+
+        case ALLOCATE_EXACT:
+            base = trunc_span_at(prev, curr, hint, length) ? hint : (vaddr_t)-1;
+            break;
+
+        case ALLOCATE_ABOVE:
+            // curr      |----h-----------------| 
+            // alloc               |------------|
+            base = curr->base + curr->length - length;
+            trunc_span_high(prev, curr, length);
+            break;
+
+        case ALLOCATE_BELOW:
+            // s    |----------------h------------|
+            //      |----------|                   
+            base = curr->base;
+            trunc_span_low(prev, curr, length);
+            break;
+
+        case ALLOCATE_NEAR:
+            // s    |-----------h-----------------|
+            //             |----------|            
+            base = near_base(curr, length, hint, 0);
+            base = trunc_span_at(prev, curr, base, length) ? base : (vaddr_t)-1;
+            break;
+        }
+
+        return base;
+    }
+
+private:
+    vaddr_t       _base;
+    size_t        _length;
+    size_t        _granularity;
+    span          _free_mem_root;
+    SpanAllocator _spans;
+
+    placement_policy _placement;
+
+    std::atomic<bool>          _deferred_free;
+    pending_free_queue         _pending_frees;
+    mutable merge_lock         _merge_lock;
+
+    // buffer used to sort the ranges released by free_many() or queued in deferred free mode, kept to avoid an
+    // allocation at each call
+    std::vector<range>         _sorted_ranges;
+
+    // managed regions, sorted by base address; the first one is the range given at construction
+    std::vector<range>         _regions;
+
+    operation_counters         _counters;
+    free_space_metrics         _metrics;
+
+    // latencies of the allocations, indexed by allocation flags, and of the releases; empty if the timing is disabled
+    std::vector<latency_histogram> _latencies;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+// Statically-defined tracepoints of the range allocator (USDT probes of the provider "rangeallocator"), for
+// bpftrace, perf or SystemTap. A probe is a single nop in the code, until a tracer attaches to it.
+// They are compiled in on Linux when <sys/sdt.h> is available (package systemtap-sdt-dev or
+// systemtap-sdt-devel), and can be removed by defining RANGE_ALLOCATOR_NO_PROBES.
+//
+//  allocate__entry  (length, flags, hint)
+//  allocate__return (length, flags, base, visited_spans)   base is (vaddr_t)-1 on failure; visited_spans is 0
+//                                                           when built with RANGE_ALLOCATOR_NO_STATS
+//  free__entry      (base, length)
+//  free__merge      (span_base, span_length)               the released range was merged into the span
+//  split            (span_base, span_length, base, length) a range was carved in the middle of a span
+//  span__exhausted  ()                                     no span available from the span manager
+//
+// e.g. bpftrace -e 'usdt:./RangeAllocator:rangeallocator:allocate__return { @visited = hist(arg3); }'
+
+#if defined(__linux__) && !defined(RANGE_ALLOCATOR_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RANGE_ALLOCATOR_PROBES
+#endif
+#endif
+
+#if defined(RANGE_ALLOCATOR_PROBES)
+#define RANGE_ALLOCATOR_PROBE0(name)                DTRACE_PROBE(rangeallocator, name)
+#define RANGE_ALLOCATOR_PROBE2(name, a, b)          DTRACE_PROBE2(rangeallocator, name, a, b)
+#define RANGE_ALLOCATOR_PROBE3(name, a, b, c)       DTRACE_PROBE3(rangeallocator, name, a, b, c)
+#define RANGE_ALLOCATOR_PROBE4(name, a, b, c, d)    DTRACE_PROBE4(rangeallocator, name, a, b, c, d)
+#else
+#define RANGE_ALLOCATOR_PROBE0(name)                ((void)0)
+#define RANGE_ALLOCATOR_PROBE2(name, a, b)          ((void)0)
+#define RANGE_ALLOCATOR_PROBE3(name, a, b, c)       ((void)0)
+#define RANGE_ALLOCATOR_PROBE4(name, a, b, c, d)    ((void)0)
+#endif
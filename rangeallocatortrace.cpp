@@ -0,0 +1,83 @@
+#include "rangeallocatortrace.h"
+
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+
+
+std::atomic<bool> range_allocator_tracing(false);
+
+// state of the trace, the calls can come from several threads
+static std::mutex                   trace_mutex;
+static FILE*                        trace_file = 0;
+static std::map<ralloc_t, uint32_t> trace_allocators;
+static uint32_t                     trace_next_allocator = 0;
+
+int start_range_allocator_trace(const char* path)
+{
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_file) return 0;
+
+    trace_file = fopen(path, "wb");
+    if (!trace_file) return 0;
+
+    trace_header header;
+    memcpy(header.magic, trace_magic, sizeof(header.magic));
+    header.version = trace_version;
+    header.record_size = sizeof(trace_record);
+    header.reserved = 0;
+    fwrite(&header, sizeof(header), 1, trace_file);
+
+    trace_allocators.clear();
+    trace_next_allocator = 0;
+    range_allocator_tracing.store(true, std::memory_order_relaxed);
+    return 1;
+}
+
+void stop_range_allocator_trace()
+{
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    range_allocator_tracing.store(false, std::memory_order_relaxed);
+
+    if (trace_file)
+    {
+        fclose(trace_file);
+        trace_file = 0;
+    }
+    trace_allocators.clear();
+}
+
+void record_range_allocator_call(trace_operation operation, ralloc_t ralloc, int flags,
+                                 uint64_t arg0, uint64_t arg1, uint64_t arg2, uint64_t result)
+{
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!trace_file) return;
+
+    trace_record record;
+    if (operation == TRACE_CREATE)
+    {
+        record.allocator = ralloc ? trace_next_allocator++ : trace_no_allocator;
+        if (ralloc) trace_allocators[ralloc] = record.allocator;
+    }
+    else
+    {
+        // the allocators created before the trace was started are not recorded
+        std::map<ralloc_t, uint32_t>::iterator it = trace_allocators.find(ralloc);
+        if (it == trace_allocators.end()) return;
+
+        record.allocator = it->second;
+
+        // the address of a destroyed allocator can be reused by a new one
+        if (operation == TRACE_DESTROY) trace_allocators.erase(it);
+    }
+
+    record.operation = (uint8_t)operation;
+    record.flags = (uint8_t)flags;
+    record.reserved = 0;
+    record.args[0] = arg0;
+    record.args[1] = arg1;
+    record.args[2] = arg2;
+    record.result = result;
+    fwrite(&record, sizeof(record), 1, trace_file);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "rangeallocator.h"
+
+#include <atomic>
+
+
+// Recording of the calls to the range allocator API, to replay them offline (see replay/replay.cpp).
+// When a trace is started, the calls made on the allocators created from then on are appended to a binary file,
+// with their arguments and results. Tracing is off by default, its cost is then a single test per call.
+// allocate_ranges() is recorded as the equivalent exact allocations, and free_ranges() as single frees.
+// The deferred free mode is not recorded, as it does not change the results.
+
+// Starts recording the calls in the file at path, which is overwritten. Returns a nonzero value on success.
+int start_range_allocator_trace(const char* path);
+
+// Stops recording the calls and closes the file.
+void stop_range_allocator_trace();
+
+
+// Format of the trace file: a header followed by fixed-size records, in the byte order of the recording machine.
+const char     trace_magic[4] = { 'R', 'A', 'T', 'R' };
+const uint32_t trace_version = 1;
+
+struct trace_header
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+enum trace_operation
+{
+    TRACE_CREATE,           // args: base, length, granularity               result: nonzero if created
+    TRACE_DESTROY,
+    TRACE_RESET,
+    TRACE_ADD_REGION,       // args: base, length                            result: nonzero on success
+    TRACE_EXTEND,           // args: additional length                       result: nonzero on success
+    TRACE_ALLOCATE,         // args: length, alignment, hint    flags        result: base address
+    TRACE_ALLOCATE_BETWEEN, // args: length, lo, hi                          result: base address
+    TRACE_RESIZE,           // args: base, old length, new length            result: base address
+    TRACE_PLACEMENT,        //                                  flags: placement policy
+    TRACE_FREE              // args: base, length
+};
+
+// identifier of the allocators that could not be created
+const uint32_t trace_no_allocator = (uint32_t)-1;
+
+struct trace_record
+{
+    uint8_t  operation;     // trace_operation
+    uint8_t  flags;         // allocation_flags, or placement_policy
+    uint16_t reserved;
+    uint32_t allocator;     // identifier of the allocator, numbered in order of creation
+    uint64_t args[3];
+    uint64_t result;
+};
+
+
+// Hooks used by the API to record the calls.
+extern std::atomic<bool> range_allocator_tracing;
+
+inline bool is_range_allocator_tracing()
+{
+    return range_allocator_tracing.load(std::memory_order_relaxed);
+}
+
+void record_range_allocator_call(trace_operation operation, ralloc_t ralloc, int flags,
+                                 uint64_t arg0, uint64_t arg1, uint64_t arg2, uint64_t result);
@@ -0,0 +1,196 @@
+#include "../rangeallocatorimpl.h"
+#include "../rangeallocatortrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+
+// Replays a trace recorded with start_range_allocator_trace() against an engine, and reports the throughput,
+// the latency percentiles and the calls whose result differs from the recorded one.
+// usage: replay <trace file> [pool|allocate|epoch]
+
+
+// Reads all the records of a trace file. Returns false if the file cannot be read or is not a trace.
+static bool read_trace(const char* path, std::vector<trace_record>& records)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    trace_header header;
+    bool valid = fread(&header, sizeof(header), 1, f) == 1
+              && memcmp(header.magic, trace_magic, sizeof(header.magic)) == 0
+              && header.version == trace_version
+              && header.record_size == sizeof(trace_record);
+
+    trace_record record;
+    while (valid && fread(&record, sizeof(record), 1, f) == 1)
+    {
+        records.push_back(record);
+    }
+    fclose(f);
+    return valid;
+}
+
+// Replays the records against allocators of type Engine, any class with the interface of range_allocator.
+template <class Engine>
+class trace_replayer
+{
+public:
+    trace_replayer()
+        : _divergences(0), _first_divergence((size_t)-1)
+    {}
+
+    ~trace_replayer()
+    {
+        for (typename std::map<uint32_t, Engine*>::iterator it = _allocators.begin(); it != _allocators.end(); ++it)
+        {
+            delete it->second;
+        }
+    }
+
+    void run(const std::vector<trace_record>& records)
+    {
+        _latencies.reserve(records.size());
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const trace_record& r = records[i];
+            if (r.allocator == trace_no_allocator) continue;
+
+            if (r.operation == TRACE_CREATE)
+            {
+                _allocators[r.allocator] = new Engine((vaddr_t)r.args[0], (size_t)r.args[1], (size_t)r.args[2]);
+                continue;
+            }
+
+            typename std::map<uint32_t, Engine*>::iterator it = _allocators.find(r.allocator);
+            if (it == _allocators.end()) continue;
+
+            if (r.operation == TRACE_DESTROY)
+            {
+                delete it->second;
+                _allocators.erase(it);
+                continue;
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            uint64_t result = execute(*it->second, r);
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            _latencies.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+            if (result != r.result)
+            {
+                if (_divergences == 0) _first_divergence = i;
+                _divergences++;
+            }
+        }
+    }
+
+    void report() const
+    {
+        std::vector<double> sorted(_latencies);
+        std::sort(sorted.begin(), sorted.end());
+
+        double total = 0;
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            total += sorted[i];
+        }
+
+        printf("operations  : %zu\n", sorted.size());
+        if (sorted.empty()) return;
+
+        printf("throughput  : %.0f ops/s\n", sorted.size() / (total * 1e-9));
+        printf("latency p50 : %.0f ns\n", percentile(sorted, 0.50));
+        printf("latency p99 : %.0f ns\n", percentile(sorted, 0.99));
+        printf("latency p999: %.0f ns\n", percentile(sorted, 0.999));
+        printf("latency max : %.0f ns\n", sorted.back());
+        printf("divergences : %zu", _divergences);
+        if (_divergences) printf(" (first at record %zu)", _first_divergence);
+        printf("\n");
+    }
+
+private:
+    // Executes a call and returns its result, 0 for the calls that have none.
+    static uint64_t execute(Engine& engine, const trace_record& r)
+    {
+        switch (r.operation)
+        {
+        case TRACE_RESET:
+            engine.reset();
+            return 0;
+        case TRACE_ADD_REGION:
+            return engine.add_region((vaddr_t)r.args[0], (size_t)r.args[1]) ? 1 : 0;
+        case TRACE_EXTEND:
+            return engine.extend((size_t)r.args[0]) ? 1 : 0;
+        case TRACE_ALLOCATE:
+            return engine.allocate((size_t)r.args[0], (allocation_flags)r.flags, (vaddr_t)r.args[2], (size_t)r.args[1]);
+        case TRACE_ALLOCATE_BETWEEN:
+            return engine.allocate_between((size_t)r.args[0], (vaddr_t)r.args[1], (vaddr_t)r.args[2]);
+        case TRACE_RESIZE:
+            return engine.resize((vaddr_t)r.args[0], (size_t)r.args[1], (size_t)r.args[2]);
+        case TRACE_PLACEMENT:
+            engine.set_placement((placement_policy)r.flags);
+            return 0;
+        case TRACE_FREE:
+            engine.free((vaddr_t)r.args[0], (size_t)r.args[1]);
+            return 0;
+        }
+        return 0;
+    }
+
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t i = (size_t)(p * (sorted.size() - 1));
+        return sorted[i];
+    }
+
+    std::map<uint32_t, Engine*> _allocators;
+    std::vector<double>         _latencies;
+    size_t                      _divergences;
+    size_t                      _first_divergence;
+};
+
+template <class Engine>
+static void replay(const std::vector<trace_record>& records)
+{
+    trace_replayer<Engine> replayer;
+    replayer.run(records);
+    replayer.report();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: replay <trace file> [pool|allocate|epoch]\n");
+        return 1;
+    }
+
+    std::vector<trace_record> records;
+    if (!read_trace(argv[1], records))
+    {
+        printf("cannot read the trace %s\n", argv[1]);
+        return 1;
+    }
+
+    const char* strategy = (argc > 2) ? argv[2] : "pool";
+    printf("trace       : %s, %zu records\n", argv[1], records.size());
+    printf("engine      : range_allocator<%s>\n", strategy);
+
+    if (strcmp(strategy, "pool") == 0)
+        replay<range_allocator<span_manager_pool> >(records);
+    else if (strcmp(strategy, "allocate") == 0)
+        replay<range_allocator<span_manager_allocate> >(records);
+    else if (strcmp(strategy, "epoch") == 0)
+        replay<range_allocator<span_manager_epoch<span_manager_pool> > >(records);
+    else
+    {
+        printf("unknown engine %s\n", strategy);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,379 @@
+#pragma once
+
+#include "rangeallocator.h"
+
+#include <atomic>
+#include <vector>
+
+
+// Represents a contiguous run of memory and can be used in a linked-list.
+// The fields are plain: the allocator rewrites the spans of the list in place, so the list must not be walked
+// by a thread while another one modifies it.
+struct span
+{
+    span*   next;
+    vaddr_t base;
+    size_t  length;
+    size_t  heap_index;     // position in the heap of the free space metrics, ordered by length
+};
+
+
+// manager of span instances that uses a pool that is fully allocated at start
+// The pool can grow by chunks: the instances of a chunk never move, so that the spans in use remain valid.
+class span_manager_pool
+{
+public:
+    span_manager_pool(size_t max_instances)
+        : _chunks(1, std::vector<span>(max_instances)), _available_spans(0), _chunk(0), _first_unused(0)
+        , _in_use(0), _high_water(0)
+    {}
+
+    ~span_manager_pool()
+    {}
+
+    span* get()
+    {
+        span* s = _available_spans;
+        if (s)
+        {
+            _available_spans = s->next;
+            count_get();
+            return s;
+        }
+        // instances that were never used are not linked in the list of available spans
+        while (_chunk < _chunks.size())
+        {
+            if (_first_unused < _chunks[_chunk].size())
+            {
+                count_get();
+                return &_chunks[_chunk][_first_unused++];
+            }
+            _chunk++;
+            _first_unused = 0;
+        }
+        return 0;
+    }
+
+    void release(span* s)
+    {
+        s->next = _available_spans;
+        _available_spans = s;
+#if !defined(RANGE_ALLOCATOR_NO_STATS)
+        _in_use--;
+#endif
+    }
+
+    // Releases the list of spans. As all the instances of the pool are then available, this is done in constant time.
+    void release_all(span* /*list*/)
+    {
+        _available_spans = 0;
+        _chunk = 0;
+        _first_unused = 0;
+        _in_use = 0;
+    }
+
+    // maximum number of instances in use at once
+    size_t high_water() const
+    {
+        return _high_water;
+    }
+
+    // Adds a chunk of <instances> spans to the pool.
+    void grow(size_t instances)
+    {
+        if (instances == 0) return;
+        _chunks.push_back(std::vector<span>(instances));
+    }
+
+    // memory blocks holding the instances of the pool
+    size_t chunk_count() const
+    {
+        return _chunks.size();
+    }
+
+    span* storage(size_t chunk = 0)
+    {
+        return _chunks[chunk].data();
+    }
+
+    size_t capacity(size_t chunk = 0) const
+    {
+        return _chunks[chunk].size();
+    }
+
+private:
+    void count_get()
+    {
+#if !defined(RANGE_ALLOCATOR_NO_STATS)
+        if (++_in_use > _high_water) _high_water = _in_use;
+#endif
+    }
+
+    std::vector<std::vector<span> > _chunks;
+    span * _available_spans;
+    size_t _chunk;
+    size_t _first_unused;
+    size_t _in_use;
+    size_t _high_water;
+};
+
+// manager of span instances that keeps a list of allocated objects and create a new one only if the list is empty
+class span_manager_allocate
+{
+public:
+    span_manager_allocate(size_t /*max_instances*/)
+    {
+        _available_spans = 0;
+        _created = 0;
+    }
+
+    ~span_manager_allocate()
+    {
+        span* current = _available_spans;
+        while (current)
+        {
+            span* next = current->next;
+            delete current;
+            current = next;
+        }
+    }
+
+    span* get()
+    {
+        span* s = _available_spans;
+        if (s)
+        {
+            _available_spans = s->next;
+            return s;
+        }
+        _created++;
+        return new span;
+    }
+
+    void release(span* s)
+    {
+        s->next = _available_spans;
+        _available_spans = s;
+    }
+
+    // Releases the list of spans at once, by appending the list of available spans to it.
+    void release_all(span* list)
+    {
+        if (!list) return;
+
+        span* last = list;
+        while (last->next)
+        {
+            last = last->next;
+        }
+        last->next = _available_spans;
+        _available_spans = list;
+    }
+
+    // Instances are created on demand: nothing to reserve.
+    void grow(size_t /*instances*/)
+    {}
+
+    // instances are never deleted before the destruction of the manager, so that the number of created
+    // instances is the maximum number of instances in use at once
+    size_t high_water() const
+    {
+        return _created;
+    }
+
+private:
+    span*  _available_spans;
+    size_t _created;
+};
+
+
+// manager of span instances that defers the recycling of released spans with an epoch-based reclamation scheme.
+// Spans are provided by another manager. A released span is retired in the current epoch; it is given back to
+// the underlying manager only when every active reader has observed a later epoch, that is when no reader
+// can still hold a pointer to it. The link of a retired span is left untouched. Entering and leaving a read-side
+// critical section are wait-free.
+// This only defers the reuse of the removed spans: it does not make the list safe to walk while the allocator
+// modifies it, since the spans that stay in the list are rewritten in place (see span).
+// get() and release() must be called by a single writer, readers can be on any thread.
+// A reader that stays in its critical section blocks the recycling: get() returns null once the underlying
+// manager is exhausted, and a range released then cannot be inserted in the list and is lost. The underlying
+// manager must be sized for the spans retired during the longest read.
+// Room is reserved for reclaim_threshold retired spans per epoch; release() only allocates when more spans are
+// retired in a single epoch, which happens when a reader stays in its critical section while they are released.
+template <class SpanManager>
+class span_manager_epoch
+{
+public:
+    static const size_t max_readers = 64;
+    static const size_t invalid_reader = (size_t)-1;
+
+    span_manager_epoch(size_t max_instances)
+        : _spans(max_instances), _global_epoch(0), _retired_count(0)
+    {
+        for (size_t i = 0; i < max_readers; i++)
+        {
+            _readers[i].store(reader_free, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < epoch_count; i++)
+        {
+            _retired[i].reserve(reclaim_threshold);
+        }
+    }
+
+    ~span_manager_epoch()
+    {
+        // no more readers: give all the retired spans back to the underlying manager
+        for (size_t i = 0; i < epoch_count; i++)
+        {
+            recycle(i);
+        }
+    }
+
+    span* get()
+    {
+        span* s = _spans.get();
+
+        // the underlying manager may be exhausted because of the retired spans: the spans of the current
+        // epoch are recycled after the epoch advanced a full cycle
+        for (size_t i = 0; !s && i < epoch_count && reclaim(); i++)
+        {
+            s = _spans.get();
+        }
+        return s;
+    }
+
+    void release(span* s)
+    {
+        // s->next is kept: a reader may still be standing on the span
+        size_t epoch = _global_epoch.load(std::memory_order_relaxed);
+        _retired[epoch % epoch_count].push_back(s);
+
+        if (++_retired_count >= reclaim_threshold)
+        {
+            reclaim();
+        }
+    }
+
+    // Releases the list of spans, each one is retired.
+    void release_all(span* list)
+    {
+        while (list)
+        {
+            span* next = list->next;
+            release(list);
+            list = next;
+        }
+    }
+
+    void grow(size_t instances)
+    {
+        _spans.grow(instances);
+    }
+
+    // the retired spans are counted as in use by the underlying manager
+    size_t high_water() const
+    {
+        return _spans.high_water();
+    }
+
+    // Registers a reader, returns its identifier or invalid_reader if there are too many readers.
+    size_t register_reader()
+    {
+        for (size_t i = 0; i < max_readers; i++)
+        {
+            size_t expected = reader_free;
+            if (_readers[i].compare_exchange_strong(expected, reader_idle))
+                return i;
+        }
+        return invalid_reader;
+    }
+
+    void unregister_reader(size_t reader)
+    {
+        _readers[reader].store(reader_free, std::memory_order_release);
+    }
+
+    // Enters a read-side critical section: the spans reachable from now on are not recycled until leave() is called.
+    void enter(size_t reader)
+    {
+        size_t epoch = _global_epoch.load(std::memory_order_relaxed);
+        _readers[reader].store(reader_active | (epoch << 2), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void leave(size_t reader)
+    {
+        _readers[reader].store(reader_idle, std::memory_order_release);
+    }
+
+    // Tries to advance the global epoch and recycles the spans that were retired two epochs ago.
+    // Returns false if an active reader has not observed the current epoch yet.
+    bool reclaim()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        size_t epoch = _global_epoch.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < max_readers; i++)
+        {
+            size_t state = _readers[i].load(std::memory_order_acquire);
+            if ((state & reader_active) && (state >> 2) != epoch)
+                return false;
+        }
+
+        // readers are either idle or in the current epoch, none of them can see the spans retired at epoch-1
+        // once they move to epoch+1: the list used at epoch+1 is the list of epoch-2, which is safe to recycle.
+        _global_epoch.store(epoch + 1, std::memory_order_release);
+        recycle((epoch + 1) % epoch_count);
+        return true;
+    }
+
+private:
+    static const size_t epoch_count = 3;
+    static const size_t reclaim_threshold = 64;
+
+    // state of a reader slot: the epoch observed by an active reader is stored above the two flag bits
+    static const size_t reader_free = 0;
+    static const size_t reader_idle = 1;
+    static const size_t reader_active = 2;
+
+    void recycle(size_t index)
+    {
+        for (size_t i = 0; i < _retired[index].size(); i++)
+        {
+            _spans.release(_retired[index][i]);
+        }
+        _retired_count -= _retired[index].size();
+        _retired[index].clear();
+    }
+
+private:
+    SpanManager         _spans;
+    std::atomic<size_t> _global_epoch;
+    std::atomic<size_t> _readers[max_readers];
+    std::vector<span*>  _retired[epoch_count];
+    size_t              _retired_count;
+};
+
+// Keeps a reader of a span_manager_epoch in a read-side critical section for its lifetime.
+template <class SpanManager>
+class epoch_guard
+{
+public:
+    epoch_guard(span_manager_epoch<SpanManager>& spans, size_t reader)
+        : _spans(spans), _reader(reader)
+    {
+        _spans.enter(_reader);
+    }
+
+    ~epoch_guard()
+    {
+        _spans.leave(_reader);
+    }
+
+private:
+    epoch_guard(const epoch_guard&);
+    epoch_guard& operator=(const epoch_guard&);
+
+    span_manager_epoch<SpanManager>& _spans;
+    size_t                           _reader;
+};
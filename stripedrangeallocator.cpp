@@ -0,0 +1,194 @@
+#include "stripedrangeallocator.h"
+#include "partitionedallocator.h"
+
+
+class striped_range_allocator : public partitioned_range_allocator
+{
+public:
+    striped_range_allocator(vaddr_t base, size_t length, size_t granularity, size_t stripe_count)
+        : partitioned_range_allocator(base, length, granularity, stripe_count)
+    {}
+
+    vaddr_t allocate(size_t length, allocation_flags flags, vaddr_t hint)
+    {
+        vaddr_t addr = (vaddr_t)-1;
+        switch (flags)
+        {
+        case ALLOCATE_ANY:
+            for (size_t i = 0; addr == (vaddr_t)-1 && i < partition_count(); i++)
+                addr = allocate_in(i, length, flags, hint);
+            break;
+
+        case ALLOCATE_EXACT:
+            // only lock the stripes covered by the range
+            return allocate_exact(length, hint);
+
+        case ALLOCATE_NEAR:
+            // the closest placement may be in any stripe
+            return allocate_across(length, flags, hint);
+
+        case ALLOCATE_ABOVE:
+            // stripes that end above the hint
+            for (size_t i = (hint < _base) ? 0 : index_of(hint); addr == (vaddr_t)-1 && i < partition_count(); i++)
+                addr = allocate_in(i, length, flags, hint);
+            break;
+
+        case ALLOCATE_BELOW:
+            // stripes that start below the hint
+            if (hint > _base)
+            {
+                for (size_t i = 0; addr == (vaddr_t)-1 && i <= index_of(hint - 1); i++)
+                    addr = allocate_in(i, length, flags, hint);
+            }
+            break;
+        }
+
+        if (addr != (vaddr_t)-1)
+            return addr;
+
+        // the request may still fit across the boundary between stripes
+        return allocate_across(length, flags, hint);
+    }
+
+private:
+
+    // Allocates with all the stripes locked, considering the free spans of adjacent stripes as a single run.
+    vaddr_t allocate_across(size_t length, allocation_flags flags, vaddr_t hint)
+    {
+        length = align_length(length);
+
+        if (length == 0) return (vaddr_t)-1;
+        if (length > _length) return (vaddr_t)-1;
+
+        std::vector<std::unique_lock<std::mutex> > locks;
+        for (size_t i = 0; i < partition_count(); i++)
+        {
+            locks.push_back(std::unique_lock<std::mutex>(_partitions[i]->mutex));
+        }
+
+        // walk the free spans of all the stripes in address order, merging the spans that touch
+        vaddr_t best = (vaddr_t)-1;
+        size_t  best_distance = (size_t)-1;
+        vaddr_t run_base = 0;
+        size_t  run_length = 0;
+        bool    found = false;
+        for (size_t i = 0; !found && i < partition_count(); i++)
+        {
+            for (const span* s = _partitions[i]->engine.first_span(); !found && s; s = s->next)
+            {
+                if (run_length && run_base + run_length == s->base)
+                {
+                    run_length += s->length;
+                    continue;
+                }
+
+                found = select_run(run_base, run_length, length, flags, hint, best, best_distance);
+                run_base = s->base;
+                run_length = s->length;
+            }
+        }
+        if (!found)
+            select_run(run_base, run_length, length, flags, hint, best, best_distance);
+
+        if (best == (vaddr_t)-1)
+            return (vaddr_t)-1;
+
+        return allocate_exact_locked(best, length) ? best : (vaddr_t)-1;
+    }
+
+    // Checks if the run satisfies the request and updates the best placement.
+    // Returns true when the search can stop, that is for all requests but ALLOCATE_NEAR.
+    bool select_run(vaddr_t base, size_t run_length, size_t length, allocation_flags flags, vaddr_t hint, vaddr_t& best, size_t& best_distance)
+    {
+        vaddr_t addr = check_run(base, run_length, length, flags, hint);
+        if (addr == (vaddr_t)-1)
+            return false;
+
+        size_t distance = (addr > hint) ? addr - hint : hint - addr;
+        if (flags == ALLOCATE_NEAR && distance >= best_distance)
+            return false;
+
+        best = addr;
+        best_distance = distance;
+        return flags != ALLOCATE_NEAR;
+    }
+
+    // Returns the address where the request would be placed in the run, with the same policy as the range
+    // allocator, or (vaddr_t)-1 if the run does not satisfy the request.
+    vaddr_t check_run(vaddr_t base, size_t run_length, size_t length, allocation_flags flags, vaddr_t hint) const
+    {
+        if (run_length < length)
+            return (vaddr_t)-1;
+
+        switch (flags)
+        {
+        case ALLOCATE_ANY:
+            return base;
+
+        case ALLOCATE_ABOVE:
+            if (base >= hint || base + run_length >= hint + length)
+                return base + run_length - length;
+            break;
+
+        case ALLOCATE_BELOW:
+            if (base + length <= hint)
+                return base;
+            break;
+
+        case ALLOCATE_NEAR:
+            if (hint <= base)
+                return base;
+            if (hint >= base + run_length - length)
+                return base + run_length - length;
+            // closest address on the granularity
+            {
+                vaddr_t below = _base + ((hint - _base) / _granularity) * _granularity;
+                return (hint - below <= below + _granularity - hint) ? below : below + _granularity;
+            }
+
+        default:
+            break;
+        }
+        return (vaddr_t)-1;
+    }
+};
+
+
+
+striped_ralloc_t create_striped_range_allocator(vaddr_t base, size_t length, size_t granularity, size_t stripe_count)
+{
+    if (!base) return 0;
+    if (!length) return 0;
+    if (!granularity) return 0;
+    if (granularity > length) return 0;
+    if (!stripe_count) return 0;
+
+    return new striped_range_allocator(base, length, granularity, stripe_count);
+}
+
+void destroy_striped_range_allocator(striped_ralloc_t ralloc)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+
+    delete static_cast<striped_range_allocator*>(ralloc);
+}
+
+vaddr_t striped_allocate_range(striped_ralloc_t ralloc, size_t length, allocation_flags flags, vaddr_t optional_hint)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return (vaddr_t)-1;
+
+    return static_cast<striped_range_allocator*>(ralloc)->allocate(length, flags, optional_hint);
+}
+
+void striped_free_range(striped_ralloc_t ralloc, vaddr_t base, size_t length)
+{
+    // check here for sanity, but we have no way to check that the pointer is valid 
+    // without adding some kind of header/signature
+    if (!ralloc) return;
+
+    static_cast<striped_range_allocator*>(ralloc)->free(base, length);
+}
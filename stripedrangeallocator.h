@@ -0,0 +1,25 @@
+#pragma once
+
+#include "rangeallocator.h"
+
+
+// Thread-safe range allocator with range-level locking.
+// The range is split into stripes, each one managed by its own range allocator and protected by its own lock.
+// ALLOCATE_EXACT requests and releases only lock the stripes covered by the range, so that operations on disjoint
+// address windows proceed in parallel. Other allocations try each stripe in turn, and fall back to locking
+// all the stripes when the request can only be satisfied across the boundary between stripes.
+typedef void *striped_ralloc_t;
+
+// Creates a thread-safe range allocator representing the range [base, base + length), split into stripe_count stripes.
+// Other parameters are the same as create_range_allocator().
+striped_ralloc_t create_striped_range_allocator(vaddr_t base, size_t length, size_t granularity, size_t stripe_count);
+
+// Frees all control structures associated with the specified range allocator.
+// No other thread must use the allocator at this time.
+void destroy_striped_range_allocator(striped_ralloc_t ralloc);
+
+// Same as allocate_range(), can be called from any thread.
+vaddr_t striped_allocate_range(striped_ralloc_t ralloc, size_t length, allocation_flags flags, vaddr_t optional_hint);
+
+// Same as free_range(), can be called from any thread.
+void striped_free_range(striped_ralloc_t ralloc, vaddr_t base, size_t length);